@@ -39,6 +39,9 @@ public:
     using size_type        = qalloc::size_type;
     using difference_type  = std::ptrdiff_t;
     using is_always_equal  = std::false_type;
+    // the pool travels with the memory, so moved and swapped containers keep their buffers
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap            = std::true_type;
 
     template <typename U>
     class rebind {
@@ -55,11 +58,21 @@ public:
 
     virtual pointer allocate(size_type n_elements);
     virtual void deallocate(pointer p, size_type n_elements);
+    pointer allocate(size_type n_elements, const void* hint);
+    allocation_result<pointer> allocate_at_least(size_type n_elements);
+    bool try_expand(pointer p, size_type n_elements_old, size_type n_elements_new);
+    bool shrink(pointer p, size_type n_elements_old, size_type n_elements_new);
+    void allocate_batch(size_type n_elements, size_type count, pointer* out);
+    void deallocate_batch(const pointer* ptrs, size_type count, size_type n_elements);
 
     QALLOC_NODISCARD
     constexpr pool_pointer pool() const noexcept;
 
 private:
+    static constexpr size_type batch_chunk_size = 256; // pointers converted on the stack per pool call
+
+    static constexpr size_type header_size = detailed ? block_info_t::header_size_of<T>() : 0;
+
     pool_pointer m_pool_ptr;
 }; // class allocator
 
@@ -71,6 +84,64 @@ using allocator = allocator_base<T, true>;
 template <typename T>
 using simple_allocator = allocator_base<T, false>;
 
+/// @brief qalloc allocator class placing every allocation on cache lines of its own.
+/// @details no other allocation shares a cache line with the returned memory,
+/// so objects written by different threads do not false share.
+/// @tparam T The type of the object to allocate.
+template <typename T>
+class isolated_allocator : public allocator_base<T, false> {
+public:
+    using typename allocator_base<T, false>::pointer;
+    using typename allocator_base<T, false>::size_type;
+
+    template <typename U>
+    class rebind {
+    public:
+        using other = isolated_allocator<U>;
+    };
+
+    using allocator_base<T, false>::allocator_base;
+    isolated_allocator() noexcept = default;
+    template <typename U>
+    explicit isolated_allocator(const isolated_allocator<U>&) noexcept;
+
+    pointer allocate(size_type n_elements) override;
+    void deallocate(pointer p, size_type n_elements) override;
+}; // class isolated_allocator
+
+/// @brief qalloc zero size allocator class using the calling thread's pool.
+/// @details nothing is stored, the pool of @b T is looked up on every allocation,
+/// so constructing and copying the allocator (e.g. in SSO string copies) costs
+/// nothing. Memory must be deallocated on the thread that allocated it.
+/// @tparam T The type of the object to allocate.
+template <typename T>
+class stateless_allocator {
+public:
+    using value_type       = T;
+    using pointer          = T*;
+    using const_pointer    = const T*;
+    using reference        = T&;
+    using const_reference  = const T&;
+    using size_type        = qalloc::size_type;
+    using difference_type  = std::ptrdiff_t;
+    using is_always_equal  = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap            = std::true_type;
+
+    template <typename U>
+    class rebind {
+    public:
+        using other = stateless_allocator<U>;
+    };
+
+    constexpr stateless_allocator() noexcept = default;
+    template <typename U>
+    constexpr stateless_allocator(const stateless_allocator<U>&) noexcept {} // NOLINT(google-explicit-constructor)
+
+    pointer allocate(size_type n_elements);
+    void deallocate(pointer p, size_type n_elements);
+}; // class stateless_allocator
+
 QALLOC_END
 
 #endif // QALLOC_ALLOCATOR_HPP
\ No newline at end of file
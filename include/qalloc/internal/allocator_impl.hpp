@@ -20,6 +20,7 @@
 #ifndef QALLOC_ALLOCATOR_IMPL_HPP
 #define QALLOC_ALLOCATOR_IMPL_HPP
 
+#include <algorithm> // std::min
 #include <qalloc/internal/allocator.hpp>
 #include <qalloc/internal/defs.hpp>
 #include <qalloc/internal/pool.hpp>
@@ -42,7 +43,7 @@ allocator_base(const allocator_base& other) noexcept
 
 template <typename T, bool detailed> template <typename U, bool U_detailed> allocator_base<T, detailed>::
 allocator_base(const allocator_base<U, U_detailed>& other) noexcept
-    : m_pool_ptr(other.pool()) {}
+    : m_pool_ptr(internal::rebound_pool<T, U>(other.pool())) {}
 
 template <typename T, bool detailed> allocator_base<T, detailed> & allocator_base<T, detailed>::
 operator=(const allocator_base<T, detailed>& other) noexcept {
@@ -73,20 +74,165 @@ deallocate(pointer p, size_type n_elements) {
     }
 }
 
+/// @brief allocate n_elements close to hint, e.g. a node next to its parent.
+template <typename T, bool detailed> typename allocator_base<T, detailed>::pointer allocator_base<T, detailed>::
+allocate(size_type n_elements, const void* hint) {
+    QALLOC_ASSERT(n_elements > 0);
+    QALLOC_IF_CONSTEXPR(detailed) {
+        return reinterpret_cast<pointer>(m_pool_ptr->template detailed_allocate_near<T>(hint, n_elements * sizeof(T)));
+    }
+    return reinterpret_cast<pointer>(m_pool_ptr->allocate_near(hint, n_elements * sizeof(T)));
+}
+
+/// @brief allocate at least n_elements, the returned count may be larger and is to be passed to deallocate.
+template <typename T, bool detailed> allocation_result<typename allocator_base<T, detailed>::pointer> allocator_base<T, detailed>::
+allocate_at_least(size_type n_elements) {
+    QALLOC_ASSERT(n_elements > 0);
+    allocation_result<byte_pointer> result;
+    QALLOC_IF_CONSTEXPR(detailed) {
+        result = m_pool_ptr->template detailed_allocate_at_least<T>(n_elements * sizeof(T));
+    }
+    else {
+        result = m_pool_ptr->allocate_at_least(n_elements * sizeof(T));
+    }
+    size_type n_usable = result.count / sizeof(T);
+    size_type n_tail = result.count - n_usable * sizeof(T);
+    if (n_tail != 0) { // bytes that cannot hold a T go back right away
+        m_pool_ptr->deallocate(result.ptr + n_usable * sizeof(T), n_tail);
+    }
+    return {reinterpret_cast<pointer>(result.ptr), n_usable};
+}
+
+/// @brief grow an allocation in place.
+/// @return true if p now holds n_elements_new elements, false if it has to be reallocated.
+template <typename T, bool detailed> bool allocator_base<T, detailed>::
+try_expand(pointer p, size_type n_elements_old, size_type n_elements_new) {
+    QALLOC_ASSERT(p != nullptr);
+    return m_pool_ptr->try_expand(
+            qalloc::pointer::launder(reinterpret_cast<byte_pointer>(p) - header_size),
+            n_elements_old * sizeof(T) + header_size,
+            n_elements_new * sizeof(T) + header_size
+    );
+}
+
+/// @brief give the unused tail of an allocation back to the pool.
+/// @return true if p now holds n_elements_new elements, false if nothing changed.
+template <typename T, bool detailed> bool allocator_base<T, detailed>::
+shrink(pointer p, size_type n_elements_old, size_type n_elements_new) {
+    QALLOC_ASSERT(p != nullptr);
+    return m_pool_ptr->shrink(
+            qalloc::pointer::launder(reinterpret_cast<byte_pointer>(p) - header_size),
+            n_elements_old * sizeof(T) + header_size,
+            n_elements_new * sizeof(T) + header_size
+    );
+}
+
+/// @brief allocate count arrays of n_elements at once.
+/// @param out receives count pointers.
+template <typename T, bool detailed> void allocator_base<T, detailed>::
+allocate_batch(size_type n_elements, size_type count, pointer* out) {
+    QALLOC_ASSERT(n_elements > 0);
+    byte_pointer blocks[batch_chunk_size];
+    for (size_type done = 0; done < count; done += batch_chunk_size) {
+        size_type n_blocks = std::min(batch_chunk_size, count - done);
+        QALLOC_IF_CONSTEXPR(detailed) {
+            m_pool_ptr->template detailed_allocate_batch<T>(n_elements * sizeof(T), n_blocks, blocks);
+        }
+        else {
+            m_pool_ptr->allocate_batch(n_elements * sizeof(T), n_blocks, blocks);
+        }
+        for (size_type i = 0; i < n_blocks; ++i) {
+            out[done + i] = reinterpret_cast<pointer>(blocks[i]);
+        }
+    }
+}
+
+/// @brief deallocate count arrays of n_elements at once.
+template <typename T, bool detailed> void allocator_base<T, detailed>::
+deallocate_batch(const pointer* ptrs, size_type count, size_type n_elements) {
+    QALLOC_ASSERT(n_elements > 0);
+    byte_pointer blocks[batch_chunk_size];
+    for (size_type done = 0; done < count; done += batch_chunk_size) {
+        size_type n_blocks = std::min(batch_chunk_size, count - done);
+        for (size_type i = 0; i < n_blocks; ++i) {
+            blocks[i] = qalloc::pointer::launder(reinterpret_cast<byte_pointer>(ptrs[done + i]));
+        }
+        QALLOC_IF_CONSTEXPR(detailed) {
+            m_pool_ptr->template detailed_deallocate_batch<T>(blocks, n_blocks, n_elements * sizeof(T));
+        }
+        else {
+            m_pool_ptr->deallocate_batch(blocks, n_blocks, n_elements * sizeof(T));
+        }
+    }
+}
+
 template <typename T, bool detailed>
 constexpr pool_pointer allocator_base<T, detailed>::pool() const noexcept {
     return m_pool_ptr;
 }
 
+template <typename T> template <typename U> isolated_allocator<T>::
+isolated_allocator(const isolated_allocator<U>& other) noexcept
+    : allocator_base<T, false>(internal::rebound_pool<T, U>(other.pool())) {}
+
+template <typename T> typename isolated_allocator<T>::pointer isolated_allocator<T>::
+allocate(size_type n_elements) {
+    QALLOC_ASSERT(n_elements > 0);
+    static_assert(alignof(T) <= QALLOC_CACHE_LINE_SIZE, "over-aligned types are not supported");
+    return reinterpret_cast<pointer>(this->pool()->allocate_isolated(n_elements * sizeof(T)));
+}
+
+template <typename T> void isolated_allocator<T>::
+deallocate(pointer p, size_type n_elements) {
+    QALLOC_ASSERT(n_elements > 0);
+    if (p == nullptr) return;
+    this->pool()->deallocate_isolated(qalloc::pointer::launder(reinterpret_cast<byte_pointer>(p)), n_elements * sizeof(T));
+}
+
+template <typename T> typename stateless_allocator<T>::pointer stateless_allocator<T>::
+allocate(size_type n_elements) {
+    QALLOC_ASSERT(n_elements > 0);
+    return reinterpret_cast<pointer>(internal::get_pool<T>()->allocate(n_elements * sizeof(T)));
+}
+
+template <typename T> void stateless_allocator<T>::
+deallocate(pointer p, size_type n_elements) {
+    QALLOC_ASSERT(n_elements > 0);
+    if (p == nullptr) return;
+    internal::get_pool<T>()->deallocate(qalloc::pointer::launder(reinterpret_cast<byte_pointer>(p)), n_elements * sizeof(T));
+}
+
+// memory from one allocator can be deallocated by another one only if both use the same pool,
+// detailed blocks carry a header that a simple allocator does not know about
 template <typename T, bool T_detailed, typename U, bool U_detailed>
-constexpr bool operator==(const allocator_base<T, T_detailed>&, const allocator_base<U, U_detailed>&) noexcept {
-    return false;
+bool operator==(const allocator_base<T, T_detailed>& lhs, const allocator_base<U, U_detailed>& rhs) noexcept {
+    return T_detailed == U_detailed && internal::is_rebound_pool<T, U>(lhs.pool(), rhs.pool());
 }
 
 template <typename T, bool T_detailed, typename U, bool U_detailed>
-constexpr bool operator!=(const allocator_base<T, T_detailed>&, const allocator_base<U, U_detailed>&) noexcept {
+bool operator!=(const allocator_base<T, T_detailed>& lhs, const allocator_base<U, U_detailed>& rhs) noexcept {
+    return !(lhs == rhs);
+}
+
+template <typename T, typename U>
+bool operator==(const isolated_allocator<T>& lhs, const isolated_allocator<U>& rhs) noexcept {
+    return internal::is_rebound_pool<T, U>(lhs.pool(), rhs.pool());
+}
+
+template <typename T, typename U>
+bool operator!=(const isolated_allocator<T>& lhs, const isolated_allocator<U>& rhs) noexcept {
+    return !(lhs == rhs);
+}
+
+template <typename T, typename U>
+constexpr bool operator==(const stateless_allocator<T>&, const stateless_allocator<U>&) noexcept {
     return true;
 }
+
+template <typename T, typename U>
+constexpr bool operator!=(const stateless_allocator<T>&, const stateless_allocator<U>&) noexcept {
+    return false;
+}
 QALLOC_END
 
 #endif // QALLOC_ALLOCATOR_IMPL_HPP
\ No newline at end of file
@@ -0,0 +1,448 @@
+// Copyright 2022 yusing. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/// @file qalloc/internal/basic_pool.hpp
+/// @brief qalloc policy based pool and allocator header file.
+/// @author yusing
+/// @date 2022-07-13
+
+#ifndef QALLOC_BASIC_POOL_HPP
+#define QALLOC_BASIC_POOL_HPP
+
+#include <algorithm> // std::lower_bound, std::find_if
+#include <cstddef>   // std::ptrdiff_t
+#include <mutex>     // std::mutex, std::lock_guard
+#include <vector>
+#include <qalloc/internal/defs.hpp>
+#include <qalloc/internal/pointer.hpp>
+#include <qalloc/internal/block.hpp>
+#include <qalloc/internal/subpool.hpp>
+#include <qalloc/internal/memory.hpp>
+#include <qalloc/internal/debug_log.hpp>
+#include <qalloc/internal/deallocation_service.hpp>
+
+QALLOC_BEGIN
+
+// Free list policies: keep the blocks given back to the pool.
+//   static size_type block_size(size_type n_bytes) - bytes actually taken for a request of n_bytes
+//   byte_pointer take(size_type n_bytes)           - a freed block of block_size(n_bytes) bytes, or nullptr
+//   void give(byte_pointer p, size_type n_bytes)   - n_bytes is a value returned by block_size()
+//   size_type bytes() const                        - bytes held by the free list
+//   static constexpr size_type alignment           - alignment of every block, given aligned subpools
+
+/// @brief free list policy keeping blocks sorted by address, first fit, adjacent blocks are merged.
+/// @details same strategy as pool_t, no rounding of the requested size.
+class sorted_free_list_t {
+public:
+    static constexpr size_type alignment = 1;
+
+    QALLOC_NODISCARD
+    static constexpr size_type block_size(size_type n_bytes) noexcept {
+        return n_bytes;
+    }
+
+    byte_pointer take(size_type n_bytes) {
+        auto it = std::find_if(m_blocks.begin(), m_blocks.end(), [n_bytes](const freed_block_t& block) {
+            return block.n_bytes >= n_bytes;
+        });
+        if (it == m_blocks.end()) {
+            return nullptr;
+        }
+        // reuse the tail of the block, the head stays in place and keeps the list sorted
+        it->n_bytes -= n_bytes;
+        byte_pointer address = it->address + it->n_bytes;
+        if (it->n_bytes == 0) {
+            m_blocks.erase(it);
+        }
+        m_bytes -= n_bytes;
+        return address;
+    }
+
+    void give(byte_pointer p, size_type n_bytes) {
+        m_bytes += n_bytes;
+        freed_block_t freed_block{n_bytes, p};
+        auto next = std::lower_bound(m_blocks.begin(), m_blocks.end(), freed_block, freed_block_t::less);
+        if (next != m_blocks.begin() && (next - 1)->is_adjacent_to(freed_block)) {
+            auto prev = next - 1;
+            prev->n_bytes += n_bytes;
+            if (next != m_blocks.end() && prev->is_adjacent_to(*next)) {
+                prev->n_bytes += next->n_bytes;
+                m_blocks.erase(next);
+            }
+            return;
+        }
+        if (next != m_blocks.end() && freed_block.is_adjacent_to(*next)) {
+            next->address = p;
+            next->n_bytes += n_bytes;
+            return;
+        }
+        m_blocks.insert(next, freed_block);
+    }
+
+    QALLOC_NODISCARD
+    size_type bytes() const noexcept {
+        return m_bytes;
+    }
+private:
+    std::vector<freed_block_t> m_blocks;
+    size_type                  m_bytes = 0;
+}; // class sorted_free_list_t
+
+/// @brief free list policy with one singly linked list per 16 byte size class.
+/// @details requests are rounded up to 16 bytes, so every block is 16 byte aligned
+/// and blocks up to @b max_small_size bytes are taken and given in O(1). Larger
+/// blocks fall back to a sorted free list.
+class size_class_free_list_t {
+public:
+    static constexpr size_type granularity = 16;
+    static constexpr size_type n_size_classes = 32;
+    static constexpr size_type max_small_size = granularity * n_size_classes;
+    static constexpr size_type alignment = granularity;
+
+    QALLOC_NODISCARD
+    static constexpr size_type block_size(size_type n_bytes) noexcept {
+        return (n_bytes + granularity - 1) & ~(granularity - 1);
+    }
+
+    byte_pointer take(size_type n_bytes) {
+        if (n_bytes > max_small_size) {
+            return m_large.take(n_bytes);
+        }
+        node_t*& head = m_heads[n_bytes / granularity - 1];
+        node_t* node = head;
+        if (node == nullptr) {
+            return nullptr;
+        }
+        head = node->next;
+        m_bytes -= n_bytes;
+        return reinterpret_cast<byte_pointer>(node);
+    }
+
+    void give(byte_pointer p, size_type n_bytes) {
+        QALLOC_ASSERT(n_bytes % granularity == 0);
+        if (n_bytes > max_small_size) {
+            m_large.give(p, n_bytes);
+            return;
+        }
+        node_t*& head = m_heads[n_bytes / granularity - 1];
+        head = new (pointer::launder(p)) node_t{head};
+        m_bytes += n_bytes;
+    }
+
+    QALLOC_NODISCARD
+    size_type bytes() const noexcept {
+        return m_bytes + m_large.bytes();
+    }
+private:
+    struct node_t {
+        node_t* next;
+    }; // struct node_t
+
+    node_t*            m_heads[n_size_classes] = {};
+    size_type          m_bytes = 0;
+    sorted_free_list_t m_large;
+}; // class size_class_free_list_t
+
+// Growth policies: size of the next subpool.
+//   static size_type next_size(size_type current_size, size_type n_bytes)
+
+/// @brief growth policy doubling the subpool size, same as pool_t.
+struct geometric_growth_t {
+    QALLOC_NODISCARD
+    static constexpr size_type next_size(size_type current_size, size_type n_bytes) noexcept {
+        return n_bytes > current_size ? n_bytes * 2 : current_size * 2;
+    }
+}; // struct geometric_growth_t
+
+/// @brief growth policy keeping every subpool at the initial size, unless a request does not fit.
+struct fixed_growth_t {
+    QALLOC_NODISCARD
+    static constexpr size_type next_size(size_type current_size, size_type n_bytes) noexcept {
+        return n_bytes > current_size ? n_bytes : current_size;
+    }
+}; // struct fixed_growth_t
+
+// Page providers: where subpools come from.
+//   static byte_pointer allocate_pages(size_type n_bytes)
+//   static void deallocate_pages(byte_pointer p, size_type n_bytes)
+
+/// @brief page provider using q_malloc and q_free.
+struct malloc_page_provider_t {
+    static byte_pointer allocate_pages(size_type n_bytes) {
+        return static_cast<byte_pointer>(q_malloc(n_bytes));
+    }
+
+    static void deallocate_pages(byte_pointer p, size_type) noexcept {
+        q_free(p);
+    }
+}; // struct malloc_page_provider_t
+
+/// @brief page provider touching every page of a new subpool, so the first allocations do not page fault.
+struct prefaulted_page_provider_t {
+    static constexpr size_type page_size = 4096;
+
+    static byte_pointer allocate_pages(size_type n_bytes) {
+        auto* begin = static_cast<byte_pointer>(q_malloc(n_bytes));
+        for (size_type offset = 0; offset < n_bytes; offset += page_size) {
+            static_cast<volatile byte*>(begin)[offset] = byte{0}; // volatile, the write must not be elided
+        }
+        return begin;
+    }
+
+    static void deallocate_pages(byte_pointer p, size_type) noexcept {
+        q_free(p);
+    }
+}; // struct prefaulted_page_provider_t
+
+/// @brief page provider giving subpools back through the deallocation service when it is running.
+struct offloaded_page_provider_t {
+    static byte_pointer allocate_pages(size_type n_bytes) {
+        return static_cast<byte_pointer>(q_malloc(n_bytes));
+    }
+
+    static void deallocate_pages(byte_pointer p, size_type n_bytes) {
+        internal::release_memory(p, n_bytes);
+    }
+}; // struct offloaded_page_provider_t
+
+// Threading policies: BasicLockable, the pool holds the lock around allocate and deallocate.
+
+/// @brief threading policy for pools used by one thread at a time, locking is a no-op.
+struct single_threaded_t {
+    void lock() noexcept {}
+    void unlock() noexcept {}
+}; // struct single_threaded_t
+
+/// @brief threading policy guarding the pool with a mutex.
+struct mutex_threaded_t {
+    void lock() { m_mutex.lock(); }
+    void unlock() { m_mutex.unlock(); }
+private:
+    std::mutex m_mutex;
+}; // struct mutex_threaded_t
+
+/// @brief qalloc policy based pool class.
+///
+/// Unlike pool_t nothing here is virtual, every policy is a template parameter,
+/// so allocate and deallocate inline into the caller, down to the free list.
+/// @tparam FreeListPolicy how freed blocks are kept and reused.
+/// @tparam GrowthPolicy size of the subpool added when the current one is exhausted.
+/// @tparam PageProvider where subpools come from and go back to.
+/// @tparam ThreadingPolicy lock held around allocate and deallocate.
+template <typename FreeListPolicy  = size_class_free_list_t,
+          typename GrowthPolicy    = geometric_growth_t,
+          typename PageProvider    = malloc_page_provider_t,
+          typename ThreadingPolicy = single_threaded_t>
+class basic_pool {
+public:
+    using free_list_policy = FreeListPolicy;
+    using growth_policy    = GrowthPolicy;
+    using page_provider    = PageProvider;
+    using threading_policy = ThreadingPolicy;
+
+    explicit basic_pool(size_type byte_size);
+    basic_pool(const basic_pool&) = delete;
+    basic_pool(basic_pool&&) = delete;
+    basic_pool& operator=(const basic_pool&) = delete;
+    basic_pool& operator=(basic_pool&&) = delete;
+    ~basic_pool();
+
+    byte_pointer allocate(size_type n_bytes) const;
+    void deallocate(byte_pointer p, size_type n_bytes) const;
+
+    QALLOC_NODISCARD
+    size_type pool_size() const noexcept;
+    QALLOC_NODISCARD
+    size_type bytes_used() const noexcept;
+private:
+    void add_subpool(size_type n_bytes) const;
+
+    mutable std::vector<subpool_t> m_subpools;
+    mutable subpool_t*             m_cur_subpool;
+    mutable FreeListPolicy         m_free_list;
+    mutable ThreadingPolicy        m_threading;
+    mutable size_type              m_pool_total;
+}; // class basic_pool
+
+/// @brief qalloc allocator class over a basic_pool, with no virtual functions.
+/// @tparam T The type of the object to allocate.
+/// @tparam Pool basic_pool instantiation to allocate from.
+template <typename T, typename Pool = basic_pool<>>
+class basic_allocator {
+public:
+    using value_type       = T;
+    using pointer          = T*;
+    using const_pointer    = const T*;
+    using reference        = T&;
+    using const_reference  = const T&;
+    using size_type        = qalloc::size_type;
+    using difference_type  = std::ptrdiff_t;
+    using is_always_equal  = std::false_type;
+    using pool_type        = Pool;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap            = std::true_type;
+
+    template <typename U>
+    class rebind {
+    public:
+        using other = basic_allocator<U, Pool>;
+    };
+
+    basic_allocator() noexcept;
+    explicit basic_allocator(const Pool& pool) noexcept;
+    template <typename U>
+    basic_allocator(const basic_allocator<U, Pool>&) noexcept; // NOLINT(google-explicit-constructor)
+
+    pointer allocate(size_type n_elements);
+    void deallocate(pointer p, size_type n_elements);
+
+    QALLOC_NODISCARD
+    constexpr const Pool* pool() const noexcept;
+private:
+    const Pool* m_pool_ptr;
+}; // class basic_allocator
+
+QALLOC_END
+
+QALLOC_INTERNAL_BEGIN
+/// @internal
+/// @brief get the thread local pool used by default constructed basic allocators.
+template <typename Pool>
+inline const Pool& get_basic_pool() {
+    // never destroyed, like the pools of get_pool(), containers may outlive the thread
+    thread_local const Pool* g_basic_pool = new Pool(4096_z);
+    return *g_basic_pool;
+}
+QALLOC_INTERNAL_END
+
+QALLOC_BEGIN
+
+template <typename F, typename G, typename P, typename L>
+inline basic_pool<F, G, P, L>::basic_pool(size_type byte_size)
+    : m_subpools     (),
+      m_cur_subpool  (nullptr),
+      m_free_list    (),
+      m_threading    (),
+      m_pool_total   (0)
+{
+    QALLOC_ASSERT(byte_size > 0);
+    add_subpool(F::block_size(byte_size));
+    debug_log("[basic pool] pool of %zu bytes constructed\n", byte_size);
+}
+
+template <typename F, typename G, typename P, typename L>
+inline basic_pool<F, G, P, L>::~basic_pool() {
+    for (const auto& subpool : m_subpools) {
+        P::deallocate_pages(pointer::remove_const(subpool.begin), subpool.size);
+    }
+}
+
+template <typename F, typename G, typename P, typename L>
+inline byte_pointer basic_pool<F, G, P, L>::allocate(size_type n_bytes) const {
+    QALLOC_ASSERT(n_bytes > 0);
+    n_bytes = F::block_size(n_bytes);
+    std::lock_guard<L> lock_guard(m_threading);
+    byte_pointer address = m_free_list.take(n_bytes);
+    if (address != nullptr) {
+        return address;
+    }
+    if (m_cur_subpool->pos + n_bytes > m_cur_subpool->end) {
+        add_subpool(F::block_size(G::next_size(m_cur_subpool->size, n_bytes)));
+    }
+    address = pointer::launder(m_cur_subpool->pos);
+    m_cur_subpool->pos += n_bytes;
+    return address;
+}
+
+template <typename F, typename G, typename P, typename L>
+inline void basic_pool<F, G, P, L>::deallocate(byte_pointer p, size_type n_bytes) const {
+    QALLOC_ASSERT(p != nullptr);
+    QALLOC_ASSERT(n_bytes > 0);
+    std::lock_guard<L> lock_guard(m_threading);
+    m_free_list.give(p, F::block_size(n_bytes));
+}
+
+template <typename F, typename G, typename P, typename L>
+inline size_type basic_pool<F, G, P, L>::pool_size() const noexcept {
+    return m_pool_total;
+}
+
+template <typename F, typename G, typename P, typename L>
+inline size_type basic_pool<F, G, P, L>::bytes_used() const noexcept {
+    return m_pool_total - m_free_list.bytes() - size_cast(m_cur_subpool->end - m_cur_subpool->pos);
+}
+
+template <typename F, typename G, typename P, typename L>
+inline void basic_pool<F, G, P, L>::add_subpool(size_type n_bytes) const {
+    QALLOC_ASSERT(n_bytes > 0);
+    debug_log("[basic pool] adding new subpool with size %zu (Thread %zu Subpool %zu)\n", n_bytes, thread_id(),
+              m_subpools.size());
+    if (m_cur_subpool != nullptr && m_cur_subpool->pos != m_cur_subpool->end) {
+        // whatever is left in the current subpool stays usable
+        m_free_list.give(m_cur_subpool->pos, size_cast(m_cur_subpool->end - m_cur_subpool->pos));
+        m_cur_subpool->pos = pointer::remove_const(m_cur_subpool->end);
+    }
+    byte_pointer begin = P::allocate_pages(n_bytes);
+    m_subpools.emplace_back(subpool_t{begin, begin + n_bytes, begin, n_bytes});
+    m_cur_subpool = &m_subpools.back();
+    m_pool_total += n_bytes;
+}
+
+template <typename T, typename Pool>
+inline basic_allocator<T, Pool>::basic_allocator() noexcept
+    : m_pool_ptr(&internal::get_basic_pool<Pool>())
+{}
+
+template <typename T, typename Pool>
+inline basic_allocator<T, Pool>::basic_allocator(const Pool& pool) noexcept
+    : m_pool_ptr(&pool)
+{}
+
+template <typename T, typename Pool>
+template <typename U>
+inline basic_allocator<T, Pool>::basic_allocator(const basic_allocator<U, Pool>& other) noexcept
+    : m_pool_ptr(other.pool())
+{}
+
+template <typename T, typename Pool>
+inline typename basic_allocator<T, Pool>::pointer basic_allocator<T, Pool>::allocate(size_type n_elements) {
+    QALLOC_ASSERT(n_elements > 0);
+    return reinterpret_cast<pointer>(m_pool_ptr->allocate(n_elements * sizeof(T)));
+}
+
+template <typename T, typename Pool>
+inline void basic_allocator<T, Pool>::deallocate(pointer p, size_type n_elements) {
+    QALLOC_ASSERT(n_elements > 0);
+    if (p == nullptr) return;
+    m_pool_ptr->deallocate(qalloc::pointer::launder(reinterpret_cast<byte_pointer>(p)), n_elements * sizeof(T));
+}
+
+template <typename T, typename Pool>
+constexpr const Pool* basic_allocator<T, Pool>::pool() const noexcept {
+    return m_pool_ptr;
+}
+
+template <typename T, typename U, typename Pool>
+constexpr bool operator==(const basic_allocator<T, Pool>& lhs, const basic_allocator<U, Pool>& rhs) noexcept {
+    return lhs.pool() == rhs.pool();
+}
+
+template <typename T, typename U, typename Pool>
+constexpr bool operator!=(const basic_allocator<T, Pool>& lhs, const basic_allocator<U, Pool>& rhs) noexcept {
+    return lhs.pool() != rhs.pool();
+}
+
+QALLOC_END
+
+#endif // QALLOC_BASIC_POOL_HPP
@@ -20,11 +20,26 @@
 #ifndef QALLOC_BLOCK_HPP
 #define QALLOC_BLOCK_HPP
 
+#include <algorithm>   // std::min
+#include <cstddef>     // std::max_align_t
+#include <cstdint>     // std::uint16_t
+#include <limits>      // std::numeric_limits
 #include <stdexcept>   // std::logic_error
-#include <type_traits> // std::forward
+#include <type_traits> // std::integral_constant
 #include <qalloc/internal/defs.hpp>
 #include <qalloc/internal/pointer.hpp>
 #include <qalloc/internal/subpool.hpp>
+#include <qalloc/internal/type_registry.hpp>
+
+QALLOC_INTERNAL_BEGIN
+/// @internal
+/// @brief alignof(T), alignof(std::max_align_t) for void, the type of detailed allocations of raw bytes that may hold anything.
+template <typename T>
+struct alignment_of : std::integral_constant<size_type, alignof(T)> {};
+
+template <>
+struct alignment_of<void> : std::integral_constant<size_type, alignof(std::max_align_t)> {};
+QALLOC_INTERNAL_END
 
 QALLOC_BEGIN
 
@@ -45,11 +60,29 @@ struct freed_block_t {
 }; // struct freed_block_t
 
 /// @brief block allocation information class.
+/// @details kept to 4 bytes, the type is a registry id and the subpool index
+/// saturates at @b unknown_subpool. It sits at the end of a header of
+/// header_size_of<T>() bytes, right before the object.
 struct block_info_t {
-    const std::type_info* type_info; // type_info of the allocated object
-    index_type subpool_index; // index of the subpool that owns this block
+    static constexpr std::uint16_t unknown_subpool = std::numeric_limits<std::uint16_t>::max();
+
+    type_id_t type_id; // registry id of the allocated object's type
+    std::uint16_t subpool_index; // index of the subpool that owns this block, or unknown_subpool
     // ... (allocated content)
 
+    template <typename T>
+    QALLOC_NODISCARD
+    static block_info_t make(size_type subpool_index) {
+        return {type_id_of<T>(), static_cast<std::uint16_t>(std::min(subpool_index, size_type(unknown_subpool)))};
+    }
+
+    /// @brief bytes in front of a T, padded to alignof(T) so a block aligned for T keeps the object aligned.
+    template <typename T>
+    QALLOC_NODISCARD
+    static constexpr size_type header_size_of() noexcept {
+        return internal::alignment_of<T>::value > sizeof(block_info_t) ? internal::alignment_of<T>::value : sizeof(block_info_t);
+    }
+
     QALLOC_NODISCARD
     static constexpr block_info_t* of(void_pointer p) {
         return pointer::sub<block_info_t*>(p, sizeof(block_info_t));
@@ -62,8 +95,9 @@ struct block_info_t {
 
     QALLOC_NODISCARD
     constexpr bool is_valid() const noexcept {
-        return type_info != nullptr;
+        return type_id != 0;
     }
 }; // struct block_info_t
+static_assert(sizeof(block_info_t) == 4, "block_info_t is not 4 bytes");
 QALLOC_END
 #endif //QALLOC_BLOCK_HPP
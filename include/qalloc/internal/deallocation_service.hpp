@@ -0,0 +1,177 @@
+// Copyright 2022 yusing. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/// @file qalloc/internal/deallocation_service.hpp
+/// @brief qalloc background deallocation service header file.
+/// @author yusing
+/// @date 2022-07-12
+
+#ifndef QALLOC_DEALLOCATION_SERVICE_HPP
+#define QALLOC_DEALLOCATION_SERVICE_HPP
+
+#include <condition_variable> // std::condition_variable
+#include <deque>
+#include <mutex>  // std::mutex, std::unique_lock
+#include <thread> // std::thread
+#include <qalloc/internal/defs.hpp>
+#include <qalloc/internal/pointer.hpp>
+#include <qalloc/internal/memory.hpp>
+#include <qalloc/internal/debug_log.hpp>
+
+QALLOC_BEGIN
+
+/// @brief qalloc background deallocation service class.
+///
+/// Hands memory going back to the system (large blocks and released subpools)
+/// to a helper thread, so the munmap and TLB shootdown behind a big free do not
+/// run on the freeing thread. The queue is bounded, when it is full the caller
+/// frees the memory itself.
+class deallocation_service_t {
+public:
+    deallocation_service_t() = default;
+    deallocation_service_t(const deallocation_service_t&) = delete;
+    deallocation_service_t& operator=(const deallocation_service_t&) = delete;
+    ~deallocation_service_t();
+
+    void start(size_type threshold = QALLOC_LARGE_BLOCK_SIZE, size_type max_queue_depth = 64_z);
+    void stop();
+    void drain();
+
+    bool submit(void_pointer p, size_type n_bytes);
+
+    QALLOC_NODISCARD
+    bool running() const;
+    QALLOC_NODISCARD
+    size_type n_freed() const;
+private:
+    void run();
+
+    mutable std::mutex       m_mutex;
+    std::condition_variable  m_not_empty;
+    std::condition_variable  m_empty;
+    std::deque<void_pointer> m_queue;
+    std::thread              m_worker;
+    size_type                m_threshold = 0;
+    size_type                m_max_queue_depth = 0;
+    size_type                m_n_freed = 0;
+    bool                     m_running = false;
+    bool                     m_busy = false; // the worker is freeing a block outside the lock
+}; // class deallocation_service_t
+
+/// @brief get the process wide deallocation service, stopped until started.
+/// @details never destroyed, static pools destroyed after it still free their large blocks through it.
+inline deallocation_service_t& deallocation_service() {
+    static auto* g_deallocation_service = new deallocation_service_t;
+    return *g_deallocation_service;
+}
+
+inline deallocation_service_t::~deallocation_service_t() {
+    stop();
+}
+
+/// @brief start the helper thread.
+/// @param threshold blocks of at least this many bytes are offloaded.
+/// @param max_queue_depth number of queued blocks before callers free by themselves.
+inline void deallocation_service_t::start(size_type threshold, size_type max_queue_depth) {
+    QALLOC_ASSERT(max_queue_depth > 0);
+    std::lock_guard<std::mutex> lock_guard(m_mutex);
+    m_threshold = threshold;
+    m_max_queue_depth = max_queue_depth;
+    if (!m_running) {
+        m_running = true;
+        m_worker = std::thread(&deallocation_service_t::run, this);
+    }
+}
+
+/// @brief free everything still queued and join the helper thread.
+inline void deallocation_service_t::stop() {
+    {
+        std::lock_guard<std::mutex> lock_guard(m_mutex);
+        if (!m_running) {
+            return;
+        }
+        m_running = false;
+    }
+    m_not_empty.notify_one();
+    m_worker.join();
+}
+
+/// @brief wait until every queued block is freed.
+inline void deallocation_service_t::drain() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_empty.wait(lock, [this]() { return (m_queue.empty() && !m_busy) || !m_running; });
+}
+
+/// @brief queue a block for the helper thread.
+/// @return false if the caller has to free the block, i.e. the service is stopped,
+/// the block is below the threshold or the queue is full.
+inline bool deallocation_service_t::submit(void_pointer p, size_type n_bytes) {
+    {
+        std::lock_guard<std::mutex> lock_guard(m_mutex);
+        if (!m_running || n_bytes < m_threshold || m_queue.size() >= m_max_queue_depth) {
+            return false;
+        }
+        m_queue.push_back(p);
+    }
+    m_not_empty.notify_one();
+    return true;
+}
+
+inline bool deallocation_service_t::running() const {
+    std::lock_guard<std::mutex> lock_guard(m_mutex);
+    return m_running;
+}
+
+/// @brief number of blocks freed by the helper thread so far.
+inline size_type deallocation_service_t::n_freed() const {
+    std::lock_guard<std::mutex> lock_guard(m_mutex);
+    return m_n_freed;
+}
+
+inline void deallocation_service_t::run() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;) {
+        m_not_empty.wait(lock, [this]() { return !m_queue.empty() || !m_running; });
+        if (m_queue.empty()) { // stopped and drained
+            break;
+        }
+        void_pointer p = m_queue.front();
+        m_queue.pop_front();
+        m_busy = true;
+        lock.unlock();
+        q_free(p);
+        lock.lock();
+        m_busy = false;
+        ++m_n_freed;
+        if (m_queue.empty()) {
+            m_empty.notify_all();
+        }
+    }
+    m_empty.notify_all();
+    debug_log("[deallocation service] stopped after freeing %zu blocks\n", m_n_freed);
+}
+
+QALLOC_END
+
+QALLOC_INTERNAL_BEGIN
+/// @internal
+/// @brief give memory obtained by q_malloc back to the system, through the deallocation service if possible.
+inline void release_memory(void_pointer p, size_type n_bytes) {
+    if (!deallocation_service().submit(p, n_bytes)) {
+        q_free(p);
+    }
+}
+QALLOC_INTERNAL_END
+
+#endif // QALLOC_DEALLOCATION_SERVICE_HPP
@@ -115,6 +115,35 @@
     #define QALLOC_CXA_DEMANGLE 0
 #endif // defined(__has_include) && __has_include(<cxxabi.h>)
 
+#if defined(__linux__) && defined(__has_include) && __has_include(<sys/rseq.h>) && defined(__has_builtin)
+    #if __has_builtin(__builtin_thread_pointer)
+        #include <sys/rseq.h>
+        #define QALLOC_HAS_RSEQ 1
+    #endif // __has_builtin(__builtin_thread_pointer)
+#endif // defined(__linux__) && defined(__has_include) && __has_include(<sys/rseq.h>) && defined(__has_builtin)
+#ifndef QALLOC_HAS_RSEQ
+    #define QALLOC_HAS_RSEQ 0
+#endif // QALLOC_HAS_RSEQ
+
+#ifndef QALLOC_CACHE_LINE_SIZE
+    #define QALLOC_CACHE_LINE_SIZE 64
+#endif // QALLOC_CACHE_LINE_SIZE
+
+#ifndef QALLOC_LARGE_BLOCK_SIZE
+    // blocks of at least this size bypass the subpools and go to the system directly
+    #define QALLOC_LARGE_BLOCK_SIZE (1024 * 1024)
+#endif // QALLOC_LARGE_BLOCK_SIZE
+
+#ifndef QALLOC_SIZE_CLASS_POOLS
+    // 1: thread pools are shared by types of the same size class instead of one pool per type
+    #define QALLOC_SIZE_CLASS_POOLS 0
+#endif // QALLOC_SIZE_CLASS_POOLS
+
+#ifndef QALLOC_DEBUG_SHARED_POOL
+    // 1: debug builds give every type the same thread pool, 0: they key thread pools like release builds
+    #define QALLOC_DEBUG_SHARED_POOL 1
+#endif // QALLOC_DEBUG_SHARED_POOL
+
 #define QALLOC_BEGIN namespace qalloc {
 #define QALLOC_END }
 #define QALLOC_INTERNAL_BEGIN QALLOC_BEGIN namespace internal {
@@ -0,0 +1,266 @@
+// Copyright 2022 yusing. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/// @file qalloc/internal/epoch.hpp
+/// @brief qalloc epoch based memory reclamation header file.
+/// @author yusing
+/// @date 2022-07-11
+
+#ifndef QALLOC_EPOCH_HPP
+#define QALLOC_EPOCH_HPP
+
+#include <algorithm> // std::sort, std::max
+#include <atomic>    // std::atomic
+#include <cstdint>   // std::uint64_t
+#include <mutex>     // std::mutex, std::lock_guard
+#include <vector>
+#include <qalloc/internal/defs.hpp>
+#include <qalloc/internal/pointer.hpp>
+#include <qalloc/internal/debug_log.hpp>
+
+QALLOC_INTERNAL_BEGIN
+
+/// @internal
+/// @brief a block retired inside a critical region, waiting to be given back to the pool it came from.
+struct retired_block_t {
+    using reclaim_function = void (*)(const void* pool, byte_pointer p, size_type n_bytes);
+
+    const void*      pool;
+    reclaim_function reclaim;
+    byte_pointer     address;
+    size_type        n_bytes;
+
+    QALLOC_NODISCARD
+    static bool less(const retired_block_t& lhs, const retired_block_t& rhs) noexcept {
+        return lhs.pool < rhs.pool || (lhs.pool == rhs.pool && lhs.address < rhs.address);
+    }
+}; // struct retired_block_t
+
+/// @internal
+/// @brief per thread epoch announcement, records are never freed, only reused.
+struct alignas(QALLOC_CACHE_LINE_SIZE) epoch_record_t {
+    std::atomic<std::uint64_t> state{0}; // (epoch << 1) | 1 while inside a critical region
+    std::atomic<bool>          in_use{true};
+    epoch_record_t*            next = nullptr;
+}; // struct epoch_record_t
+
+/// @internal
+/// @brief give retired blocks back to their pools, one sorted batch per pool.
+/// @return number of bytes given back.
+inline size_type reclaim_blocks(std::vector<retired_block_t>& blocks) {
+    size_type n_bytes = 0;
+    std::sort(blocks.begin(), blocks.end(), retired_block_t::less);
+    for (const auto& block : blocks) {
+        block.reclaim(block.pool, block.address, block.n_bytes);
+        n_bytes += block.n_bytes;
+    }
+    blocks.clear();
+    return n_bytes;
+}
+
+/// @internal
+/// @brief global epoch and the list of thread records.
+class epoch_domain_t {
+public:
+    std::atomic<std::uint64_t>     epoch{0};
+    std::atomic<epoch_record_t*>   records{nullptr};
+    std::mutex                     orphans_mutex;
+    std::vector<retired_block_t>   orphans;          // left behind by exited threads
+    std::uint64_t                  orphans_epoch{0}; // latest epoch any orphan was retired in
+
+    epoch_record_t* acquire_record() {
+        for (epoch_record_t* record = records.load(std::memory_order_acquire); record != nullptr; record = record->next) {
+            bool expected = false;
+            if (record->in_use.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+                return record;
+            }
+        }
+        auto* record = new epoch_record_t;
+        epoch_record_t* head = records.load(std::memory_order_relaxed);
+        do {
+            record->next = head;
+        } while (!records.compare_exchange_weak(head, record, std::memory_order_release, std::memory_order_relaxed));
+        return record;
+    }
+
+    /// @brief advance the global epoch if every thread inside a critical region has seen it.
+    bool try_advance() {
+        std::uint64_t current = epoch.load(std::memory_order_seq_cst);
+        for (epoch_record_t* record = records.load(std::memory_order_acquire); record != nullptr; record = record->next) {
+            std::uint64_t state = record->state.load(std::memory_order_seq_cst);
+            if ((state & 1u) != 0 && (state >> 1) != current) {
+                return false;
+            }
+        }
+        return epoch.compare_exchange_strong(current, current + 1, std::memory_order_seq_cst);
+    }
+
+    size_type reclaim_orphans() {
+        std::lock_guard<std::mutex> lock_guard(orphans_mutex);
+        if (orphans.empty() || orphans_epoch + 2 > epoch.load(std::memory_order_acquire)) {
+            return 0;
+        }
+        return reclaim_blocks(orphans);
+    }
+}; // class epoch_domain_t
+
+/// @internal
+inline epoch_domain_t& get_epoch_domain() {
+    static epoch_domain_t g_epoch_domain;
+    return g_epoch_domain;
+}
+
+/// @internal
+/// @brief thread local epoch state: announcement record, nesting depth and the limbo bags.
+class epoch_thread_t {
+public:
+    static constexpr size_type n_bags = 3;
+    static constexpr size_type reclaim_threshold = 64; // retired blocks before trying to reclaim
+
+    epoch_record_t*              record;
+    size_type                    nesting = 0;
+    size_type                    n_retired = 0;
+    std::vector<retired_block_t> bags[n_bags];
+    std::uint64_t                bag_epochs[n_bags] = {};
+
+    epoch_thread_t() : record(get_epoch_domain().acquire_record()) {}
+    epoch_thread_t(const epoch_thread_t&) = delete;
+    epoch_thread_t& operator=(const epoch_thread_t&) = delete;
+
+    ~epoch_thread_t() {
+        record->state.store(0, std::memory_order_release);
+        reclaim();
+        epoch_domain_t& domain = get_epoch_domain();
+        if (n_retired != 0) {
+            std::lock_guard<std::mutex> lock_guard(domain.orphans_mutex);
+            for (size_type i = 0; i < n_bags; ++i) {
+                domain.orphans.insert(domain.orphans.end(), bags[i].begin(), bags[i].end());
+                domain.orphans_epoch = std::max(domain.orphans_epoch, bag_epochs[i]);
+            }
+        }
+        record->in_use.store(false, std::memory_order_release);
+    }
+
+    void retire(const retired_block_t& block) {
+        std::uint64_t current = get_epoch_domain().epoch.load(std::memory_order_acquire);
+        size_type i = static_cast<size_type>(current % n_bags);
+        if (bag_epochs[i] != current) {
+            // the bag still holds blocks retired three or more epochs ago, which are safe by now
+            n_retired -= bags[i].size();
+            reclaim_blocks(bags[i]);
+            bag_epochs[i] = current;
+        }
+        bags[i].push_back(block);
+        if (++n_retired >= reclaim_threshold) {
+            reclaim();
+        }
+    }
+
+    size_type reclaim() {
+        epoch_domain_t& domain = get_epoch_domain();
+        domain.try_advance();
+        std::uint64_t current = domain.epoch.load(std::memory_order_acquire);
+        size_type n_bytes = 0;
+        for (size_type i = 0; i < n_bags; ++i) {
+            // no thread can still hold a block retired two epochs ago
+            if (!bags[i].empty() && bag_epochs[i] + 2 <= current) {
+                n_retired -= bags[i].size();
+                n_bytes += reclaim_blocks(bags[i]);
+            }
+        }
+        n_bytes += domain.reclaim_orphans();
+        debug_log("[epoch] reclaimed %zu bytes at epoch %llu\n", n_bytes, static_cast<unsigned long long>(current));
+        return n_bytes;
+    }
+}; // class epoch_thread_t
+
+/// @internal
+inline epoch_thread_t& get_epoch_thread() {
+    thread_local epoch_thread_t g_epoch_thread;
+    return g_epoch_thread;
+}
+
+QALLOC_INTERNAL_END
+
+QALLOC_BEGIN
+
+/// @brief epoch based memory reclamation.
+///
+/// Readers wrap every access to a shared lock-free structure in a critical
+/// region (@ref epoch::guard). Writers unlink a node, then @ref epoch::retire it
+/// instead of deallocating it, the block is handed back to its pool once every
+/// thread has left the critical regions it could have been seen in.
+namespace epoch {
+
+/// @brief enter a critical region, regions can be nested.
+inline void enter() {
+    internal::epoch_thread_t& thread = internal::get_epoch_thread();
+    if (thread.nesting++ == 0) {
+        std::uint64_t current = internal::get_epoch_domain().epoch.load(std::memory_order_seq_cst);
+        thread.record->state.store((current << 1) | 1u, std::memory_order_seq_cst);
+    }
+}
+
+/// @brief leave a critical region.
+inline void exit() {
+    internal::epoch_thread_t& thread = internal::get_epoch_thread();
+    QALLOC_ASSERT(thread.nesting > 0);
+    if (--thread.nesting == 0) {
+        thread.record->state.store(0, std::memory_order_release);
+    }
+}
+
+/// @brief RAII critical region.
+class guard {
+public:
+    guard() { enter(); }
+    guard(const guard&) = delete;
+    guard& operator=(const guard&) = delete;
+    ~guard() { exit(); }
+}; // class guard
+
+/// @brief defer the deallocation of a block until no critical region can reference it.
+/// @details the pool is recorded with the block and the block always goes back to it. When the
+/// calling thread exits first, its blocks are orphaned and another thread gives them back later,
+/// under a lock shared by all orphans.
+/// @tparam Pool pool type, must be safe to deallocate into from the calling thread, and from any
+/// thread once the calling thread has exited.
+/// @param pool pool the block was allocated from, must outlive the retired block.
+/// @param p pointer to the block.
+/// @param n_bytes size of the block as passed to @b Pool::deallocate.
+template <typename Pool>
+void retire(const Pool* pool, void_pointer p, size_type n_bytes) {
+    QALLOC_ASSERT(pool != nullptr);
+    QALLOC_ASSERT(p != nullptr);
+    internal::get_epoch_thread().retire(internal::retired_block_t{
+        pool,
+        [](const void* pool, byte_pointer p, size_type n_bytes) {
+            static_cast<const Pool*>(pool)->deallocate(p, n_bytes);
+        },
+        static_cast<byte_pointer>(p),
+        n_bytes
+    });
+}
+
+/// @brief try to advance the global epoch and give back the blocks that became safe.
+/// @return number of bytes given back to their pools.
+inline size_type reclaim() {
+    return internal::get_epoch_thread().reclaim();
+}
+
+} // namespace epoch
+
+QALLOC_END
+
+#endif // QALLOC_EPOCH_HPP
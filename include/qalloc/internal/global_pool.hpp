@@ -24,57 +24,139 @@
 #include <string>
 #include <utility> // std::pair
 #include <type_traits>  // std::is_scalar, std::integral_constant, std::void_t, std::false_type, std::true_type
-#include <mutex> // std::mutex, std::lock_guard
-#include <atomic> // std::atomic
+#include <memory> // std::unique_ptr
 #include <qalloc/internal/allocator.hpp>
 #include <qalloc/internal/defs.hpp>
 #include <qalloc/internal/memory.hpp>
+#include <qalloc/internal/pool_traits.hpp>
 
 QALLOC_INTERNAL_BEGIN
 /// @internal
+/// @details the slot is thread local, no other thread can see it, so a plain
+/// load is enough, no atomics or locking on the allocation path.
 template <size_type POOL_SIZE>
-inline pool_pointer initialize_pool_if_needed(std::atomic<pool_pointer>& pool_atomic) {
-    static std::mutex g_pool_mutex;
-    pool_pointer p_pool = pool_atomic.load(std::memory_order_relaxed);
-    std::atomic_thread_fence(std::memory_order_acquire);
+inline pool_pointer initialize_pool_if_needed(pool_pointer& p_pool) {
     if (p_pool == nullptr) {
-        std::lock_guard<std::mutex> lock_guard(g_pool_mutex);
-        p_pool = pool_atomic.load(std::memory_order_relaxed);
-        if (p_pool == nullptr) { // double-check
-            p_pool = new pool_t(POOL_SIZE);
-            atomic_thread_fence(std::memory_order_release);
-            pool_atomic.store(p_pool, std::memory_order_relaxed);
-        }
+        p_pool = new pool_t(POOL_SIZE);
     }
     return p_pool;
 }
 
+thread_local pool_pointer g_pool_shared = nullptr;
+
+constexpr size_type min_pool_size_class = 8;
+constexpr size_type n_pool_size_classes = 8; // 8, 16, ..., 512 and everything larger
+
+/// @internal
+/// @brief index of the smallest size class holding @b n_bytes, the last class takes everything larger.
+constexpr size_type pool_size_class_of(size_type n_bytes, size_type size_class = 0) {
+    return size_class + 1 == n_pool_size_classes || (min_pool_size_class << size_class) >= n_bytes
+           ? size_class
+           : pool_size_class_of(n_bytes, size_class + 1);
+}
+
+/// @internal
+/// @brief size class of the pool of @b T, over-aligned types go up to a class of their alignment.
+template <typename T>
+constexpr size_type pool_size_class_of() {
+    return pool_size_class_of(sizeof(T) > alignof(T) ? sizeof(T) : alignof(T));
+}
+
 #if QALLOC_CXX_14
 /*
  * Using different pool for different type can reduce memory fragmentation.
  * Might slightly improve performance.
  */
-    thread_local std::atomic<pool_pointer> g_pool_shared;
+    template <typename T>
+    thread_local pool_pointer g_pool_unique = nullptr;
+
+/*
+ * With many types and threads, the idle space of one pool per type adds up.
+ * Size class pools bound it to n_pool_size_classes pools per thread, the block
+ * header of detailed allocations still records the type.
+ */
+    template <size_type SIZE_CLASS>
+    thread_local pool_pointer g_pool_size_class = nullptr;
 
     template <typename T>
-    thread_local std::atomic<pool_pointer> g_pool_unique;
+    pool_pointer& pool_slot() {
+#if QALLOC_DEBUG && QALLOC_DEBUG_SHARED_POOL
+        return g_pool_shared;
+#elif QALLOC_SIZE_CLASS_POOLS
+        return g_pool_size_class<pool_size_class_of<T>()>;
+#else // QALLOC_DEBUG
+        return g_pool_unique<T>;
+#endif // QALLOC_DEBUG
+    }
 
     template <typename T>
     pool_pointer get_pool() {
-#if QALLOC_DEBUG
+#if QALLOC_DEBUG && QALLOC_DEBUG_SHARED_POOL
         // use shared pool for debug mode
-        return initialize_pool_if_needed<256>(g_pool_shared);
+        return initialize_pool_if_needed<256>(pool_slot<T>());
+#elif QALLOC_SIZE_CLASS_POOLS
+        return initialize_pool_if_needed<(min_pool_size_class << pool_size_class_of<T>()) * 16>(pool_slot<T>());
 #else // QALLOC_DEBUG
-        return initialize_pool_if_needed<sizeof(T) * 16>(g_pool_unique<T>); // the initial size does not affect performance much, just keep it small
+        return initialize_pool_if_needed<pool_traits<T>::initial_size>(pool_slot<T>()); // small by default, hot types can raise it through pool_traits
 #endif // QALLOC_DEBUG
     }
 #else // QALLOC_CXX_14
     // use ahared pool for all types in C++11 or earlier, since variable templates is not supported
     template <typename>
+    pool_pointer& pool_slot() {
+        return g_pool_shared;
+    }
+
+    template <typename T>
     pool_pointer get_pool() {
-        return initialize_pool_if_needed<256>(g_pool_shared);
+        return initialize_pool_if_needed<256>(pool_slot<T>());
     }
 #endif // QALLOC_CXX_14
 
+/// @internal
+/// @brief pool for an allocator of @b T rebound from an allocator of @b U using @b p_pool.
+/// @details the default pool of @b U is swapped for the default pool of @b T, so node
+/// based containers get a pool of equally sized nodes, custom pools are kept.
+template <typename T, typename U>
+pool_pointer rebound_pool(pool_pointer p_pool) {
+    return p_pool == pool_slot<U>() ? get_pool<T>() : p_pool;
+}
+
+/// @internal
+/// @brief whether p_pool_t is what rebound_pool<T, U>() makes of p_pool_u, without creating a pool.
+template <typename T, typename U>
+bool is_rebound_pool(pool_pointer p_pool_t, pool_pointer p_pool_u) noexcept {
+    return p_pool_u == pool_slot<U>() ? p_pool_t == pool_slot<T>() : p_pool_t == p_pool_u;
+}
+
 QALLOC_INTERNAL_END
+
+QALLOC_BEGIN
+/// @brief take ownership of the calling thread's pool of @b T.
+/// @details with QALLOC_SIZE_CLASS_POOLS this is the pool of the whole size class of @b T.
+/// containers built on the pool keep working wherever the returned
+/// pool goes, e.g. to another thread, the next allocation of @b T on the calling
+/// thread starts a new pool.
+/// @tparam T type whose pool is detached.
+/// @return the detached pool, or nullptr if the thread has not allocated @b T yet.
+template <typename T>
+std::unique_ptr<pool_t> detach_pool() {
+    pool_pointer& slot = internal::pool_slot<T>();
+    pool_pointer p_pool = slot;
+    slot = nullptr;
+    return std::unique_ptr<pool_t>(const_cast<pool_t*>(p_pool));
+}
+
+/// @brief make a pool the calling thread's pool of @b T.
+/// @tparam T type whose pool is replaced.
+/// @param p_pool pool to adopt, e.g. one detached on another thread.
+/// @return the previous pool of the calling thread, which keeps the memory of the containers built on it.
+template <typename T>
+std::unique_ptr<pool_t> adopt_pool(std::unique_ptr<pool_t> p_pool) {
+    pool_pointer& slot = internal::pool_slot<T>();
+    pool_pointer p_previous = slot;
+    slot = p_pool.release();
+    return std::unique_ptr<pool_t>(const_cast<pool_t*>(p_previous));
+}
+QALLOC_END
 #endif // QALLOC_GLOBAL_POOL_HPP
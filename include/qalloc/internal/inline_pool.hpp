@@ -0,0 +1,149 @@
+// Copyright 2022 yusing. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/// @file qalloc/internal/inline_pool.hpp
+/// @brief qalloc pool starting on an inline buffer header file.
+/// @author yusing
+/// @date 2022-07-16
+
+#ifndef QALLOC_INLINE_POOL_HPP
+#define QALLOC_INLINE_POOL_HPP
+
+#include <cstddef>     // std::ptrdiff_t, std::max_align_t
+#include <type_traits> // std::false_type
+#include <qalloc/internal/defs.hpp>
+#include <qalloc/internal/pointer.hpp>
+#include <qalloc/internal/pool.hpp>
+#include <qalloc/internal/pool_impl.hpp>
+#include <qalloc/internal/pool_base_impl.hpp>
+
+QALLOC_INTERNAL_BEGIN
+/// @internal
+/// @brief the buffer of inline_pool, a base class so it is there before pool_t is constructed.
+template <size_type N>
+struct inline_buffer_t {
+    alignas(std::max_align_t) byte m_buffer[N];
+}; // struct inline_buffer_t
+QALLOC_INTERNAL_END
+
+QALLOC_BEGIN
+
+/// @brief qalloc pool whose first subpool is an N byte buffer inside the pool object.
+/// @details on the stack or as a member, small allocations never reach the system
+/// allocator nor a thread pool. On overflow it grows with normal subpools.
+/// The pool can not be moved, its allocations point into itself.
+/// @code
+/// qalloc::inline_pool<256> pool;
+/// std::vector<int, qalloc::inline_allocator<int, 256>> v(pool);
+/// @endcode
+/// @tparam N size of the inline buffer in bytes.
+template <size_type N>
+class inline_pool : private internal::inline_buffer_t<N>, public pool_t {
+public:
+    static_assert(N > 0, "the inline buffer can not be empty");
+
+    inline_pool() noexcept;
+    inline_pool(const inline_pool&) = delete;
+    inline_pool(inline_pool&&) = delete;
+    inline_pool& operator=(const inline_pool&) = delete;
+    inline_pool& operator=(inline_pool&&) = delete;
+    ~inline_pool() override = default;
+
+    QALLOC_NODISCARD
+    static constexpr size_type inline_size() noexcept;
+}; // class inline_pool
+
+/// @brief qalloc allocator class using an inline_pool<N>.
+/// @tparam T The type of the object to allocate.
+/// @tparam N size of the inline buffer of the pool.
+template <typename T, size_type N>
+class inline_allocator {
+public:
+    using value_type       = T;
+    using pointer          = T*;
+    using const_pointer    = const T*;
+    using reference        = T&;
+    using const_reference  = const T&;
+    using size_type        = qalloc::size_type;
+    using difference_type  = std::ptrdiff_t;
+    using is_always_equal  = std::false_type;
+    using pool_type        = inline_pool<N>;
+
+    template <typename U>
+    class rebind {
+    public:
+        using other = inline_allocator<U, N>;
+    };
+
+    inline_allocator(const pool_type& pool) noexcept; // NOLINT(google-explicit-constructor)
+    template <typename U>
+    inline_allocator(const inline_allocator<U, N>& other) noexcept; // NOLINT(google-explicit-constructor)
+
+    pointer allocate(size_type n_elements);
+    void deallocate(pointer p, size_type n_elements);
+
+    QALLOC_NODISCARD
+    constexpr const pool_type* pool() const noexcept;
+private:
+    const pool_type* m_pool_ptr;
+}; // class inline_allocator
+
+template <size_type N> inline_pool<N>::
+inline_pool() noexcept
+    : internal::inline_buffer_t<N>(), pool_t(this->m_buffer, N) {}
+
+template <size_type N>
+constexpr size_type inline_pool<N>::inline_size() noexcept {
+    return N;
+}
+
+template <typename T, size_type N> inline_allocator<T, N>::
+inline_allocator(const pool_type& pool) noexcept
+    : m_pool_ptr(&pool) {}
+
+template <typename T, size_type N> template <typename U> inline_allocator<T, N>::
+inline_allocator(const inline_allocator<U, N>& other) noexcept
+    : m_pool_ptr(other.pool()) {}
+
+template <typename T, size_type N> typename inline_allocator<T, N>::pointer inline_allocator<T, N>::
+allocate(size_type n_elements) {
+    QALLOC_ASSERT(n_elements > 0);
+    return reinterpret_cast<pointer>(m_pool_ptr->allocate(n_elements * sizeof(T)));
+}
+
+template <typename T, size_type N> void inline_allocator<T, N>::
+deallocate(pointer p, size_type n_elements) {
+    QALLOC_ASSERT(n_elements > 0);
+    if (p == nullptr) return;
+    m_pool_ptr->deallocate(reinterpret_cast<byte_pointer>(p), n_elements * sizeof(T));
+}
+
+template <typename T, size_type N>
+constexpr const typename inline_allocator<T, N>::pool_type* inline_allocator<T, N>::pool() const noexcept {
+    return m_pool_ptr;
+}
+
+template <typename T, typename U, size_type N>
+constexpr bool operator==(const inline_allocator<T, N>& lhs, const inline_allocator<U, N>& rhs) noexcept {
+    return lhs.pool() == rhs.pool();
+}
+
+template <typename T, typename U, size_type N>
+constexpr bool operator!=(const inline_allocator<T, N>& lhs, const inline_allocator<U, N>& rhs) noexcept {
+    return !(lhs == rhs);
+}
+
+QALLOC_END
+
+#endif // QALLOC_INLINE_POOL_HPP
@@ -0,0 +1,197 @@
+// Copyright 2022 yusing. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/// @file qalloc/internal/object_pool.hpp
+/// @brief qalloc typed slab allocator header file.
+/// @author yusing
+/// @date 2022-07-17
+
+#ifndef QALLOC_OBJECT_POOL_HPP
+#define QALLOC_OBJECT_POOL_HPP
+
+#include <algorithm> // std::max, std::remove_if
+#include <cstdint>   // std::uintptr_t
+#include <new>       // placement new
+#include <utility>   // std::forward
+#include <vector>
+#include <qalloc/internal/defs.hpp>
+#include <qalloc/internal/debug_log.hpp>
+#include <qalloc/internal/pointer.hpp>
+#include <qalloc/internal/pool.hpp>
+#include <qalloc/internal/pool_impl.hpp>
+#include <qalloc/internal/pool_base_impl.hpp>
+
+QALLOC_BEGIN
+
+/// @brief pool of fixed size slots for objects of type @b T.
+/// @details objects carry no header. Dead slots hold the free list, so create()
+/// and destroy() are O(1). Slots are carved from slabs aligned to their own
+/// size (at least a page), so the slab of a slot is found by masking its address.
+/// Objects still alive when the pool is destroyed are not destroyed.
+/// @tparam T The type of the objects.
+template <typename T>
+class object_pool {
+public:
+    object_pool();
+    object_pool(const object_pool&) = delete;
+    object_pool& operator=(const object_pool&) = delete;
+    ~object_pool() = default;
+
+    template <typename... Args>
+    T* create(Args&&... args);
+    void destroy(T* p);
+
+    void reserve(size_type n_objects);
+    void shrink_to_fit();
+
+    QALLOC_NODISCARD
+    size_type size() const noexcept;
+    QALLOC_NODISCARD
+    size_type capacity() const noexcept;
+
+    static constexpr size_type page_size = 4096;
+private:
+    struct free_slot_t {
+        free_slot_t* next;
+    }; // struct free_slot_t
+
+    struct slab_t {
+        size_type n_live;
+    }; // struct slab_t
+
+    static constexpr size_type align_up(size_type n, size_type alignment) noexcept {
+        return (n + alignment - 1) / alignment * alignment;
+    }
+
+    static constexpr size_type slot_alignment = std::max(alignof(T), alignof(free_slot_t));
+    static constexpr size_type slot_size = align_up(std::max(sizeof(T), sizeof(free_slot_t)), slot_alignment);
+    static constexpr size_type slots_offset = align_up(sizeof(slab_t), slot_alignment);
+
+    static constexpr size_type slab_size_for(size_type n_bytes) noexcept {
+        size_type size = page_size;
+        while (size < n_bytes) {
+            size *= 2;
+        }
+        return size;
+    }
+
+    static constexpr size_type slab_size = slab_size_for(slots_offset + slot_size * 8);
+    static constexpr size_type slots_per_slab = (slab_size - slots_offset) / slot_size;
+
+    static slab_t* slab_of(const void* p) noexcept;
+    void add_slab();
+
+    pool_t               m_pool;
+    std::vector<slab_t*> m_slabs;
+    free_slot_t*         m_free_list = nullptr;
+    size_type            m_size = 0;
+}; // class object_pool
+
+/// @details slabs of at least QALLOC_LARGE_BLOCK_SIZE come from the system, the first subpool is not made for them.
+template <typename T> object_pool<T>::
+object_pool() : m_pool(slab_size < QALLOC_LARGE_BLOCK_SIZE ? slab_size * 2 : page_size) {}
+
+/// @brief construct an object in a free slot.
+template <typename T> template <typename... Args>
+T* object_pool<T>::create(Args&&... args) {
+    if (m_free_list == nullptr) {
+        add_slab();
+    }
+    free_slot_t* slot = m_free_list;
+    m_free_list = slot->next; // read before the object overwrites it
+    T* p;
+    try {
+        p = new (static_cast<void_pointer>(slot)) T(std::forward<Args>(args)...);
+    }
+    catch (...) {
+        m_free_list = new (static_cast<void_pointer>(slot)) free_slot_t{m_free_list};
+        throw;
+    }
+    ++slab_of(p)->n_live;
+    ++m_size;
+    return p;
+}
+
+/// @brief destroy an object created by this pool and free its slot.
+template <typename T>
+void object_pool<T>::destroy(T* p) {
+    if (p == nullptr) return;
+    p->~T();
+    --slab_of(p)->n_live;
+    --m_size;
+    auto* slot = new (static_cast<void_pointer>(p)) free_slot_t{m_free_list};
+    m_free_list = slot;
+}
+
+/// @brief add slabs until n_objects fit without allocating.
+template <typename T>
+void object_pool<T>::reserve(size_type n_objects) {
+    while (capacity() < n_objects) {
+        add_slab();
+    }
+}
+
+/// @brief give slabs without live objects back to the underlying pool, and wholly free subpools to the system.
+template <typename T>
+void object_pool<T>::shrink_to_fit() {
+    free_slot_t** link = &m_free_list;
+    while (*link != nullptr) { // unlink the slots of the empty slabs
+        if (slab_of(*link)->n_live == 0) {
+            *link = (*link)->next;
+        }
+        else {
+            link = &(*link)->next;
+        }
+    }
+    auto it = std::remove_if(m_slabs.begin(), m_slabs.end(), [this](slab_t* slab) {
+        if (slab->n_live != 0) {
+            return false;
+        }
+        m_pool.deallocate(reinterpret_cast<byte_pointer>(slab), slab_size);
+        return true;
+    });
+    m_slabs.erase(it, m_slabs.end());
+    m_pool.gc();
+}
+
+template <typename T>
+size_type object_pool<T>::size() const noexcept {
+    return m_size;
+}
+
+template <typename T>
+size_type object_pool<T>::capacity() const noexcept {
+    return m_slabs.size() * slots_per_slab;
+}
+
+template <typename T>
+typename object_pool<T>::slab_t* object_pool<T>::slab_of(const void* p) noexcept {
+    return reinterpret_cast<slab_t*>(reinterpret_cast<std::uintptr_t>(p) & ~(std::uintptr_t(slab_size) - 1));
+}
+
+template <typename T>
+void object_pool<T>::add_slab() {
+    byte_pointer begin = m_pool.allocate_aligned(slab_size, slab_size);
+    auto* slab = new (static_cast<void_pointer>(begin)) slab_t{0};
+    m_slabs.push_back(slab);
+    // pushed in reverse, so the slots are handed out in address order
+    for (size_type i = slots_per_slab; i-- > 0;) {
+        m_free_list = new (static_cast<void_pointer>(begin + slots_offset + i * slot_size)) free_slot_t{m_free_list};
+    }
+    debug_log("[object pool] added a slab of %zu slots @ %p (Thread %zu)\n", slots_per_slab, begin, thread_id());
+}
+
+QALLOC_END
+
+#endif // QALLOC_OBJECT_POOL_HPP
@@ -0,0 +1,269 @@
+// Copyright 2022 yusing. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/// @file qalloc/internal/percpu_pool.hpp
+/// @brief qalloc per-cpu pool class header file.
+/// @author yusing
+/// @date 2022-07-10
+
+#ifndef QALLOC_PERCPU_POOL_HPP
+#define QALLOC_PERCPU_POOL_HPP
+
+#include <algorithm> // std::max
+#include <atomic> // std::atomic_flag
+#include <cstddef> // std::max_align_t
+#include <memory> // std::unique_ptr
+#include <mutex> // std::lock_guard
+#include <thread> // std::thread::hardware_concurrency, std::this_thread::yield
+#include <qalloc/internal/defs.hpp>
+#include <qalloc/internal/pointer.hpp>
+#include <qalloc/internal/debug_log.hpp>
+#include <qalloc/internal/pool.hpp>
+#include <qalloc/internal/global_pool.hpp>
+
+QALLOC_INTERNAL_BEGIN
+/// @internal
+/// @brief get the cpu number of the calling thread from its rseq area.
+/// @return cpu number, or -1 if rseq is not registered for the calling thread.
+inline int rseq_cpu_id() noexcept {
+#if QALLOC_HAS_RSEQ
+    if (__rseq_size == 0) {
+        return -1;
+    }
+    const auto* area = reinterpret_cast<const volatile struct rseq*>(
+            static_cast<const char*>(__builtin_thread_pointer()) + __rseq_offset
+    );
+    // RSEQ_CPU_ID_UNINITIALIZED and RSEQ_CPU_ID_REGISTRATION_FAILED are negative
+    int cpu = static_cast<int>(area->cpu_id);
+    return cpu < 0 ? -1 : cpu;
+#else
+    return -1;
+#endif // QALLOC_HAS_RSEQ
+}
+
+/// @internal
+/// @brief stand-in for the cpu number of threads without rseq, spreads the threads over the slots.
+inline size_type thread_slot_hint() noexcept {
+    static std::atomic<size_type> g_n_threads{0};
+    thread_local const size_type g_hint = g_n_threads.fetch_add(1, std::memory_order_relaxed);
+    return g_hint;
+}
+QALLOC_INTERNAL_END
+
+QALLOC_BEGIN
+
+/// @brief per-cpu block information class, stored before every block of a per-cpu pool.
+/// @details padded to alignof(std::max_align_t), so the block after it keeps its alignment.
+struct alignas(std::max_align_t) percpu_block_t {
+    index_type slot; // index of the owning cpu slot
+
+    QALLOC_NODISCARD
+    static constexpr percpu_block_t* of(void_pointer p) {
+        return pointer::sub<percpu_block_t*>(p, sizeof(percpu_block_t));
+    }
+}; // struct percpu_block_t
+static_assert(sizeof(percpu_block_t) == alignof(std::max_align_t), "percpu_block_t is not padded");
+
+/// @brief qalloc per-cpu pool class.
+///
+/// One pool per cpu, selected by the cpu number the kernel publishes in the
+/// rseq area of the calling thread. The cpu number only picks the slot, every
+/// slot is guarded by its own spin lock, so a thread migrated or preempted in
+/// the middle of an allocation is still safe. Threads without a registered
+/// rseq area pick their slot by a per-thread number instead, every block is
+/// owned by a slot, so it can be freed from any thread.
+/// The allocation itself is not a restartable sequence: that would take per
+/// architecture assembly for the commit step, the lock keeps the slot pool
+/// portable and is almost never contended, since it is keyed by cpu.
+class percpu_pool_t {
+public:
+    explicit percpu_pool_t(size_type byte_size_per_cpu);
+    percpu_pool_t(const percpu_pool_t&) = delete;
+    percpu_pool_t(percpu_pool_t&&) = delete;
+    percpu_pool_t& operator=(const percpu_pool_t&) = delete;
+    percpu_pool_t& operator=(percpu_pool_t&&) = delete;
+    ~percpu_pool_t();
+
+    byte_pointer allocate(size_type n_bytes) const;
+    void deallocate(byte_pointer p, size_type n_bytes) const;
+
+    QALLOC_NODISCARD
+    size_type n_slots() const noexcept;
+    size_type pool_size() const noexcept;
+    size_type bytes_used() const noexcept;
+private:
+    struct alignas(QALLOC_CACHE_LINE_SIZE) slot_t {
+        mutable std::atomic_flag flag = ATOMIC_FLAG_INIT;
+        mutable pool_t*          pool = nullptr; // constructed on first use of the cpu
+
+        // Lockable, so std::lock_guard releases it on exceptions too
+        void lock() const noexcept;
+        void unlock() const noexcept;
+    }; // struct slot_t
+
+    std::unique_ptr<slot_t[]> m_slots;
+    size_type                 m_n_slots;
+    size_type                 m_slot_size;
+}; // class percpu_pool_t
+
+/// @brief qalloc allocator class backed by the process wide per-cpu pool.
+/// @tparam T The type of the object to allocate.
+template <typename T>
+class percpu_allocator {
+public:
+    using value_type       = T;
+    using pointer          = T*;
+    using const_pointer    = const T*;
+    using reference        = T&;
+    using const_reference  = const T&;
+    using size_type        = qalloc::size_type;
+    using difference_type  = std::ptrdiff_t;
+    using is_always_equal  = std::true_type;
+
+    template <typename U>
+    class rebind {
+    public:
+        using other = percpu_allocator<U>;
+    };
+
+    percpu_allocator() noexcept = default;
+    template <typename U>
+    percpu_allocator(const percpu_allocator<U>&) noexcept {} // NOLINT(google-explicit-constructor)
+
+    pointer allocate(size_type n_elements);
+    void deallocate(pointer p, size_type n_elements);
+}; // class percpu_allocator
+
+QALLOC_END
+
+QALLOC_INTERNAL_BEGIN
+/// @internal
+/// @brief get the process wide per-cpu pool.
+inline const percpu_pool_t& get_percpu_pool() {
+    static const percpu_pool_t g_percpu_pool(4096_z);
+    return g_percpu_pool;
+}
+QALLOC_INTERNAL_END
+
+QALLOC_BEGIN
+
+inline void percpu_pool_t::slot_t::lock() const noexcept {
+    while (flag.test_and_set(std::memory_order_acquire)) {
+        std::this_thread::yield();
+    }
+}
+
+inline void percpu_pool_t::slot_t::unlock() const noexcept {
+    flag.clear(std::memory_order_release);
+}
+
+inline percpu_pool_t::percpu_pool_t(size_type byte_size_per_cpu)
+    : m_slots     (),
+      m_n_slots   (std::max(1_z, static_cast<size_type>(std::thread::hardware_concurrency()))),
+      m_slot_size (byte_size_per_cpu)
+{
+    QALLOC_ASSERT(byte_size_per_cpu > 0);
+    m_slots.reset(new slot_t[m_n_slots]);
+    debug_log("[percpu] pool of %zu slots constructed\n", m_n_slots);
+}
+
+inline percpu_pool_t::~percpu_pool_t() {
+    for (size_type i = 0; i < m_n_slots; ++i) {
+        delete m_slots[i].pool;
+    }
+}
+
+inline byte_pointer percpu_pool_t::allocate(size_type n_bytes) const {
+    int cpu = internal::rseq_cpu_id();
+    // cpu numbers can be sparse, so they are folded into the available slots
+    size_type i = (cpu < 0 ? internal::thread_slot_hint() : static_cast<size_type>(cpu)) % m_n_slots;
+    const slot_t& slot = m_slots[i];
+    byte_pointer p;
+    {
+        std::lock_guard<const slot_t> lock_guard(slot);
+        if (slot.pool == nullptr) {
+            slot.pool = new pool_t(m_slot_size);
+        }
+        p = slot.pool->allocate(n_bytes + sizeof(percpu_block_t));
+    }
+    new (pointer::launder(p)) percpu_block_t{static_cast<index_type>(i)};
+    return p + sizeof(percpu_block_t);
+}
+
+inline void percpu_pool_t::deallocate(byte_pointer p, size_type n_bytes) const {
+    QALLOC_ASSERT(p != nullptr);
+    index_type slot_index = percpu_block_t::of(p)->slot;
+    QALLOC_ASSERT(size_cast(slot_index) < m_n_slots);
+    // the block goes back to the slot it came from, not the one of the calling thread
+    const slot_t& slot = m_slots[size_cast(slot_index)];
+    std::lock_guard<const slot_t> lock_guard(slot);
+    slot.pool->deallocate(pointer::launder(p - sizeof(percpu_block_t)), n_bytes + sizeof(percpu_block_t));
+}
+
+inline size_type percpu_pool_t::n_slots() const noexcept {
+    return m_n_slots;
+}
+
+inline size_type percpu_pool_t::pool_size() const noexcept {
+    size_type total = 0;
+    for (size_type i = 0; i < m_n_slots; ++i) {
+        const slot_t& slot = m_slots[i];
+        std::lock_guard<const slot_t> lock_guard(slot);
+        if (slot.pool != nullptr) {
+            total += slot.pool->pool_size();
+        }
+    }
+    return total;
+}
+
+inline size_type percpu_pool_t::bytes_used() const noexcept {
+    size_type total = 0;
+    for (size_type i = 0; i < m_n_slots; ++i) {
+        const slot_t& slot = m_slots[i];
+        std::lock_guard<const slot_t> lock_guard(slot);
+        if (slot.pool != nullptr) {
+            total += slot.pool->bytes_used();
+        }
+    }
+    return total;
+}
+
+template <typename T> typename percpu_allocator<T>::pointer percpu_allocator<T>::
+allocate(size_type n_elements) {
+    QALLOC_ASSERT(n_elements > 0);
+    return reinterpret_cast<pointer>(internal::get_percpu_pool().allocate(n_elements * sizeof(T)));
+}
+
+template <typename T> void percpu_allocator<T>::
+deallocate(pointer p, size_type n_elements) {
+    QALLOC_ASSERT(n_elements > 0);
+    if (p == nullptr) return;
+    internal::get_percpu_pool().deallocate(
+            qalloc::pointer::launder(reinterpret_cast<byte_pointer>(p)), n_elements * sizeof(T)
+    );
+}
+
+template <typename T, typename U>
+constexpr bool operator==(const percpu_allocator<T>&, const percpu_allocator<U>&) noexcept {
+    return true;
+}
+
+template <typename T, typename U>
+constexpr bool operator!=(const percpu_allocator<T>&, const percpu_allocator<U>&) noexcept {
+    return false;
+}
+
+QALLOC_END
+
+#endif // QALLOC_PERCPU_POOL_HPP
@@ -22,6 +22,7 @@
 
 #include <ostream>
 #include <utility>
+#include <cstdint> // std::uintptr_t
 #include <qalloc/internal/defs.hpp>
 
 QALLOC_BEGIN
@@ -135,6 +136,22 @@ constexpr byte_pointer remove_const(const_byte_pointer p) {
     return const_cast<byte_pointer>(launder(p));
 }
 
+/// @brief round a pointer up to the next multiple of alignment
+/// @param p pointer to be aligned
+/// @param alignment power of 2 alignment
+/// @return aligned pointer
+inline byte_pointer align_up(byte_pointer p, size_type alignment) {
+    auto address = reinterpret_cast<std::uintptr_t>(p);
+    return p + (((address + alignment - 1) & ~(alignment - 1)) - address);
+}
+
+/// @brief check whether a pointer is a multiple of alignment
+/// @param p pointer to be checked
+/// @param alignment power of 2 alignment
+inline bool is_aligned(const_void_pointer p, size_type alignment) {
+    return (reinterpret_cast<std::uintptr_t>(p) & (alignment - 1)) == 0;
+}
+
 } // namespace pointer
 QALLOC_END
 
@@ -35,10 +35,43 @@ public:
     byte_pointer detailed_allocate(size_type n_bytes_requested) const;
     template <class T>
     void detailed_deallocate(byte_pointer p, size_type n_bytes_requested) const;
+    template <class T>
+    byte_pointer detailed_allocate_near(const_void_pointer hint, size_type n_bytes_requested) const;
+    template <class T>
+    allocation_result<byte_pointer> detailed_allocate_at_least(size_type n_bytes_requested) const;
+    template <class T>
+    void detailed_allocate_batch(size_type n_bytes_requested, size_type count, byte_pointer* out) const;
+    template <class T>
+    void detailed_deallocate_batch(byte_pointer* blocks, size_type count, size_type n_bytes_requested) const;
     size_type gc() const;
+private:
+    template <class T>
+    byte_pointer add_header(byte_pointer block) const;
 }; // class pool_t
 
 using pool_pointer = const pool_t*;
 
+/// @brief RAII checkpoint, everything allocated from the bump region of the pool
+/// while the scope is alive is given back at once when it ends.
+/// @code
+/// {
+///     qalloc::scope phase(pool);
+///     build_temporaries(pool);
+/// } // rewound here
+/// @endcode
+class scope {
+public:
+    explicit scope(const pool_base_t& pool) noexcept;
+    scope(const scope&) = delete;
+    scope& operator=(const scope&) = delete;
+    ~scope();
+
+    QALLOC_NODISCARD
+    const pool_checkpoint_t& mark() const noexcept;
+private:
+    const pool_base_t& m_pool;
+    pool_checkpoint_t  m_mark;
+}; // class scope
+
 QALLOC_END
 #endif //QALLOC_POOL_HPP
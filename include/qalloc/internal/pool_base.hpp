@@ -27,23 +27,73 @@
 
 QALLOC_BEGIN
 
+/// @brief pointer and usable size of an allocation, like std::allocation_result of C++23.
+template <typename Pointer>
+struct allocation_result {
+    Pointer   ptr;
+    size_type count;
+}; // struct allocation_result
+
+/// @brief position of a pool saved by pool_base_t::checkpoint(), see pool_base_t::rewind().
+struct pool_checkpoint_t {
+    size_type    subpool_index;
+    byte_pointer pos;
+    size_type    n_subpools; // the ones added later are released by rewind()
+}; // struct pool_checkpoint_t
+
+/// @brief how a pool handles deallocations.
+enum class pool_mode : unsigned char {
+    immediate, // every free is merged into the sorted free list right away
+    deferred,  // frees are buffered, then sorted and coalesced in one pass when the buffer fills or memory runs out
+    monotonic  // frees are ignored, memory comes back all at once with release()
+}; // enum class pool_mode
+
+/// @brief expected lifetime of an allocation, used to place it.
+enum class lifetime_class : unsigned char {
+    normal,     // placed anywhere
+    short_lived // placed in subpools of its own, so they empty completely and gc() can release them
+}; // enum class lifetime_class
+
 /// @brief qalloc pool base class.
 class pool_base_t {
 public:
     pool_base_t() = delete;
-    explicit pool_base_t(size_type byte_size);
+    explicit pool_base_t(size_type byte_size, const pool_base_t* upstream = nullptr);
     pool_base_t(const pool_base_t&) = delete;
-    pool_base_t(pool_base_t&&) = delete;
+    pool_base_t(pool_base_t&&) noexcept;
     pool_base_t& operator=(const pool_base_t&) = delete;
-    pool_base_t& operator=(pool_base_t&&) = delete;
+    pool_base_t& operator=(pool_base_t&&) noexcept;
     virtual ~pool_base_t();
 
     byte_pointer allocate(size_type n_bytes) const;
+    byte_pointer allocate(size_type n_bytes, lifetime_class lifetime) const;
     template <bool merge = true>
     void deallocate(byte_pointer p, size_type n_bytes) const;
+    byte_pointer allocate_aligned(size_type n_bytes, size_type alignment) const;
+    byte_pointer allocate_isolated(size_type n_bytes) const;
+    void deallocate_isolated(byte_pointer p, size_type n_bytes) const;
+    allocation_result<byte_pointer> allocate_at_least(size_type n_bytes) const;
+    bool try_expand(byte_pointer p, size_type n_bytes_old, size_type n_bytes_new) const;
+    bool shrink(byte_pointer p, size_type n_bytes_old, size_type n_bytes_new) const;
+    byte_pointer allocate_near(const_void_pointer hint, size_type n_bytes) const;
+    void allocate_batch(size_type n_bytes, size_type count, byte_pointer* out) const;
+    void deallocate_batch(const byte_pointer* blocks, size_type count, size_type n_bytes) const;
+
+    void set_mode(pool_mode mode) const;
+    QALLOC_NODISCARD
+    pool_mode mode() const noexcept;
+    void flush_deferred() const;
+    void release() const;
+    QALLOC_NODISCARD
+    pool_checkpoint_t checkpoint() const noexcept;
+    void rewind(const pool_checkpoint_t& mark) const;
 
     constexpr size_type pool_size() const noexcept;
     size_type bytes_used() const noexcept;
+    size_type padding_bytes() const noexcept;
+    size_type large_bytes() const noexcept;
+    QALLOC_NODISCARD
+    const pool_base_t* upstream() const noexcept;
 
     QALLOC_MALLOC_FUNCTION(void_pointer operator new(size_type));
     void operator delete(QALLOC_RESTRICT void_pointer p);
@@ -51,14 +101,50 @@ public:
     // debugging
     void print_info(bool usage_only = false) const;
 protected:
+    /// @brief large block aligned above what q_malloc guarantees.
+    struct large_block_t {
+        byte_pointer address; // handed out
+        byte_pointer base;    // returned by q_malloc
+        size_type    n_bytes; // allocated from the system
+    }; // struct large_block_t
+
+    pool_base_t(byte_pointer buffer, size_type byte_size); // the first subpool is a buffer owned by the caller
+
+    const pool_base_t*                  m_upstream;       // pool supplying the subpools, nullptr for the system
+    const_byte_pointer                  m_inline_buffer;  // first subpool when it is not owned by the pool, see inline_pool
     mutable std::vector<subpool_t>      m_subpools;       // linked list of subpools
     mutable subpool_t*                  m_cur_subpool;    // pointer to current subpool
     mutable std::vector<freed_block_t>  m_freed_blocks;   // vector of freed blocks
     mutable size_type                   m_pool_total;     // sum of all subpools' sizes
+    mutable size_type                   m_padding_total;  // bytes lost to rounding isolated blocks to cache lines
+    mutable size_type                   m_large_total;    // bytes in blocks allocated directly from the system
+    mutable std::vector<large_block_t>  m_aligned_large_blocks; // large blocks aligned inside a bigger system allocation
+    mutable std::vector<freed_block_t>  m_deferred_blocks; // frees not merged yet, in deferred mode
+    mutable pool_mode                   m_mode;
+    mutable size_type                   m_nursery;        // index of the subpool taking short lived allocations, or no_nursery
+    mutable size_type                   m_n_nurseries;    // short lived subpools not released yet
     bool is_valid(void_pointer p) const noexcept;
-    static subpool_t new_subpool(size_type n_bytes) ; // n_bytes >= 1
+    template <bool merge = true>
+    void free_block(byte_pointer p, size_type n_bytes) const;
+    subpool_t new_subpool(size_type n_bytes) const; // n_bytes >= 1
+    void release_subpool(const subpool_t& subpool) const;
     void add_subpool(size_type n_bytes) const;
+    void next_subpool(size_type n_bytes_needed, size_type n_bytes_new) const;
+    void free_tail() const;
+    byte_pointer allocate_large(size_type n_bytes, size_type alignment) const;
+    void deallocate_large(byte_pointer p, size_type n_bytes) const;
+    void add_nursery(size_type n_bytes) const;
+    bool free_to_nursery(byte_pointer p, size_type n_bytes) const;
+    void drop_subpool(size_type index) const;
+    void release_subpools() noexcept;
     constexpr bool can_allocate(size_type n_bytes) const noexcept;
+    QALLOC_NODISCARD
+    static constexpr size_type isolated_size_of(size_type n_bytes) noexcept;
+
+    static constexpr size_type min_split_size = 32; // smaller remainders are handed out by allocate_at_least
+    static constexpr size_type deferred_buffer_size = 128; // least buffered frees before a flush in deferred mode
+    static constexpr size_type near_scan_limit = 32; // freed blocks looked at on each side of a hint
+    static constexpr size_type no_nursery = static_cast<size_type>(-1);
 }; // class pool_base_t
 QALLOC_END
 
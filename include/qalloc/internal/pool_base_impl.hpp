@@ -20,19 +20,32 @@
 #ifndef QALLOC_POOL_BASE_IMPL_HPP
 #define QALLOC_POOL_BASE_IMPL_HPP
 
-#include <algorithm> // std::find_if
+#include <algorithm> // std::find_if, std::sort, std::max, std::remove_if
+#include <cstddef>   // std::max_align_t
 #include <qalloc/internal/pool_base.hpp>
 #include <qalloc/internal/debug_log.hpp>
 #include <qalloc/internal/memory.hpp>
 #include <qalloc/internal/type_info.hpp>
+#include <qalloc/internal/deallocation_service.hpp>
 
 QALLOC_BEGIN
 
-inline pool_base_t::pool_base_t(size_type byte_size)
-    : m_subpools       (1_z, new_subpool(byte_size)),
+/// @param upstream pool the subpools are allocated from and given back to, the system if nullptr.
+/// it has to outlive this pool and be usable from the threads using this pool.
+inline pool_base_t::pool_base_t(size_type byte_size, const pool_base_t* upstream)
+    : m_upstream       (upstream),
+      m_inline_buffer  (nullptr),
+      m_subpools       (1_z, new_subpool(byte_size)),
       m_cur_subpool    (&m_subpools.front()),
       m_freed_blocks   (),
-      m_pool_total     (byte_size)
+      m_pool_total     (byte_size),
+      m_padding_total  (0),
+      m_large_total    (0),
+      m_aligned_large_blocks(),
+      m_deferred_blocks(),
+      m_mode           (pool_mode::immediate),
+      m_nursery        (no_nursery),
+      m_n_nurseries    (0)
 {
     QALLOC_ASSERT(byte_size > 0);
     QALLOC_ASSERT(!m_subpools.empty());
@@ -40,16 +53,105 @@ inline pool_base_t::pool_base_t(size_type byte_size)
     debug_log("[pool] pool of %zu bytes constructed\n", byte_size);
 }
 
+inline pool_base_t::pool_base_t(byte_pointer buffer, size_type byte_size)
+    : m_upstream       (nullptr),
+      m_inline_buffer  (buffer),
+      m_subpools       (1_z, subpool_t{buffer, buffer + byte_size, buffer, byte_size}),
+      m_cur_subpool    (&m_subpools.front()),
+      m_freed_blocks   (),
+      m_pool_total     (byte_size),
+      m_padding_total  (0),
+      m_large_total    (0),
+      m_aligned_large_blocks(),
+      m_deferred_blocks(),
+      m_mode           (pool_mode::immediate),
+      m_nursery        (no_nursery),
+      m_n_nurseries    (0)
+{
+    QALLOC_ASSERT(buffer != nullptr);
+    QALLOC_ASSERT(byte_size > 0);
+    debug_log("[pool] pool of %zu bytes constructed on a buffer @ %p\n", byte_size, buffer);
+}
+
+// moving the vector keeps its buffer, so m_cur_subpool stays valid in the new owner.
+// a moved-from pool owns nothing and may only be destroyed or assigned to.
+inline pool_base_t::pool_base_t(pool_base_t&& other) noexcept
+    : m_upstream       (other.m_upstream),
+      m_inline_buffer  (other.m_inline_buffer),
+      m_subpools       (std::move(other.m_subpools)),
+      m_cur_subpool    (other.m_cur_subpool),
+      m_freed_blocks   (std::move(other.m_freed_blocks)),
+      m_pool_total     (other.m_pool_total),
+      m_padding_total  (other.m_padding_total),
+      m_large_total    (other.m_large_total),
+      m_aligned_large_blocks(std::move(other.m_aligned_large_blocks)),
+      m_deferred_blocks(std::move(other.m_deferred_blocks)),
+      m_mode           (other.m_mode),
+      m_nursery        (other.m_nursery),
+      m_n_nurseries    (other.m_n_nurseries)
+{
+    other.m_subpools.clear();
+    other.m_cur_subpool = nullptr;
+    other.m_freed_blocks.clear();
+    other.m_pool_total = 0;
+    other.m_padding_total = 0;
+    other.m_large_total = 0;
+    other.m_aligned_large_blocks.clear();
+    other.m_deferred_blocks.clear();
+    debug_log("[pool] pool of %zu bytes moved\n", m_pool_total);
+}
+
+inline pool_base_t& pool_base_t::operator=(pool_base_t&& other) noexcept {
+    if (this != &other) {
+        release_subpools();
+        m_upstream = other.m_upstream;
+        m_inline_buffer = other.m_inline_buffer;
+        m_subpools = std::move(other.m_subpools);
+        m_cur_subpool = other.m_cur_subpool;
+        m_freed_blocks = std::move(other.m_freed_blocks);
+        m_pool_total = other.m_pool_total;
+        m_padding_total = other.m_padding_total;
+        m_large_total = other.m_large_total;
+        m_aligned_large_blocks = std::move(other.m_aligned_large_blocks);
+        m_deferred_blocks = std::move(other.m_deferred_blocks);
+        m_mode = other.m_mode;
+        m_nursery = other.m_nursery;
+        m_n_nurseries = other.m_n_nurseries;
+        other.m_subpools.clear();
+        other.m_cur_subpool = nullptr;
+        other.m_freed_blocks.clear();
+        other.m_pool_total = 0;
+        other.m_padding_total = 0;
+        other.m_large_total = 0;
+        other.m_aligned_large_blocks.clear();
+        other.m_deferred_blocks.clear();
+    }
+    return *this;
+}
+
 inline pool_base_t::~pool_base_t() { // TODO: fix, never triggers, but does not affect program behavior
     debug_log("%s\n", "[pool] pool destructed");
-    QALLOC_DEBUG_STATEMENT(print_info(true);)
+    QALLOC_DEBUG_STATEMENT(if (m_cur_subpool != nullptr) print_info(true);)
+    release_subpools();
+}
+
+inline void pool_base_t::release_subpools() noexcept {
     for (const auto& subpool : m_subpools) {
-        q_free(pointer::remove_const(subpool.begin));
+        if (subpool.begin != nullptr) {
+            release_subpool(subpool);
+        }
     }
+    m_subpools.clear();
+    m_deferred_blocks.clear();
+    m_cur_subpool = nullptr;
+    m_nursery = no_nursery;
+    m_n_nurseries = 0;
 }
 
-inline subpool_t pool_base_t::new_subpool(size_type n_bytes) {
-    QALLOC_RESTRICT byte_pointer begin = static_cast<byte_pointer>(q_malloc(n_bytes)); // NOLINT(modernize-use-auto)
+inline subpool_t pool_base_t::new_subpool(size_type n_bytes) const {
+    QALLOC_RESTRICT byte_pointer begin = m_upstream != nullptr // NOLINT(modernize-use-auto)
+            ? m_upstream->allocate_aligned(n_bytes, alignof(std::max_align_t))
+            : static_cast<byte_pointer>(q_malloc(n_bytes));
     QALLOC_RESTRICT byte_pointer end   = begin + n_bytes;
     return subpool_t{
         begin,  // .begin
@@ -59,8 +161,28 @@ inline subpool_t pool_base_t::new_subpool(size_type n_bytes) {
     };
 }
 
+/// @brief give the memory of a subpool back to where new_subpool() got it from.
+inline void pool_base_t::release_subpool(const subpool_t& subpool) const {
+    if (subpool.begin == m_inline_buffer) { // owned by the caller
+        return;
+    }
+    if (m_upstream != nullptr) {
+        m_upstream->deallocate(pointer::remove_const(subpool.begin), subpool.size);
+    }
+    else {
+        internal::release_memory(pointer::remove_const(subpool.begin), subpool.size);
+    }
+}
+
 inline byte_pointer pool_base_t::allocate(size_type n_bytes) const {
     QALLOC_ASSERT(n_bytes > 0);
+    if (n_bytes >= QALLOC_LARGE_BLOCK_SIZE) {
+        // a subpool twice that size would mostly stay empty
+        return allocate_large(n_bytes, alignof(std::max_align_t));
+    }
+    if (!m_deferred_blocks.empty() && !can_allocate(n_bytes)) {
+        flush_deferred(); // slow path, buffered frees may hold the space we need
+    }
     // if current pool cannot allocate n_bytes
     // no need to check the freed blocks (assumed they are smaller than n_bytes)
     if (can_allocate(n_bytes)) {
@@ -80,7 +202,7 @@ inline byte_pointer pool_base_t::allocate(size_type n_bytes) const {
             if (reused_block.n_bytes > n_bytes) { // split if it has extra space left
                 // deallocate the first (reused_block.n_bytes - n_bytes) bytes
                 size_type size_left = reused_block.n_bytes - n_bytes;
-                deallocate(reused_block.address, size_left);
+                free_block(reused_block.address, size_left);
                 // and then reuse from the last n_bytes bytes of the block
                 // to keep block info (i.e. subpool index and type info) at the beginning of the block
                 reused_block.address += size_left;
@@ -95,7 +217,7 @@ inline byte_pointer pool_base_t::allocate(size_type n_bytes) const {
     else {
         // memory exhausted in pool
         // add new subpool with 2 * (n_bytes || m_cur_subpool->size) (larger one)
-        add_subpool(std::max(n_bytes * 2, m_cur_subpool->size * 2));
+        next_subpool(n_bytes, std::max(n_bytes * 2, m_cur_subpool->size * 2));
     }
 
     byte_pointer address = pointer::launder(m_cur_subpool->pos);
@@ -108,81 +230,667 @@ inline byte_pointer pool_base_t::allocate(size_type n_bytes) const {
     return address;
 }
 
+/// @brief allocate n_bytes placed by their expected lifetime.
+/// @details short lived blocks are bumped from nursery subpools that take nothing else, so once they
+/// are all deallocated the whole subpool is free and gc() can release it. The unused end of a filled
+/// nursery is not reused.
+inline byte_pointer pool_base_t::allocate(size_type n_bytes, lifetime_class lifetime) const {
+    if (lifetime == lifetime_class::normal || n_bytes >= QALLOC_LARGE_BLOCK_SIZE) {
+        return allocate(n_bytes);
+    }
+    QALLOC_ASSERT(n_bytes > 0);
+    if (m_nursery == no_nursery || m_subpools[m_nursery].pos + n_bytes > m_subpools[m_nursery].end) {
+        add_nursery(std::max(n_bytes * 2, m_cur_subpool->size));
+    }
+    subpool_t& nursery = m_subpools[m_nursery];
+    byte_pointer address = pointer::launder(nursery.pos);
+    nursery.pos += n_bytes;
+    debug_log("[allocate] allocated %zu short lived bytes @ %p (Thread %zu Subpool %zu)\n", n_bytes, address,
+              thread_id(), m_nursery + 1);
+    return address;
+}
+
 template <bool merge>
 inline void pool_base_t::deallocate(byte_pointer p, size_type n_bytes) const {
+    QALLOC_ASSERT(p != nullptr);
+    QALLOC_ASSERT(n_bytes > 0);
+    if (n_bytes >= QALLOC_LARGE_BLOCK_SIZE) {
+        deallocate_large(p, n_bytes);
+        return;
+    }
+    if (m_mode == pool_mode::monotonic) { // given back by release()
+        QALLOC_ASSERT(is_valid(p));
+        return;
+    }
+    if (free_to_nursery(p, n_bytes)) {
+        return;
+    }
+    if (m_mode == pool_mode::deferred) {
+        QALLOC_ASSERT(is_valid(p));
+        m_deferred_blocks.emplace_back(freed_block_t{n_bytes, p});
+        // growing with the free list keeps the merge passes linear in the number of frees
+        if (m_deferred_blocks.size() >= std::max(deferred_buffer_size, m_freed_blocks.size())) {
+            flush_deferred();
+        }
+        return;
+    }
+    free_block<merge>(p, n_bytes);
+}
+
+template <bool merge>
+inline void pool_base_t::free_block(byte_pointer p, size_type n_bytes) const {
     QALLOC_ASSERT(p != nullptr);
     QALLOC_ASSERT(n_bytes > 0);
     QALLOC_ASSERT(is_valid(p));
+    if (m_mode == pool_mode::monotonic) { // leftovers are not tracked either
+        return;
+    }
+
+    freed_block_t freed_block{n_bytes, p};
+    // make sure the freed block is sorted by address in ascending order (in order to merge blocks)
+    auto next = std::lower_bound(m_freed_blocks.begin(), m_freed_blocks.end(), freed_block, freed_block_t::less);
+    QALLOC_IF_CONSTEXPR(merge) {
+        // the list is always coalesced, so only the two neighbors can be adjacent
+        if (next != m_freed_blocks.begin() && (next - 1)->is_adjacent_to(freed_block)) { // is adjacent to the previous block
+            auto prev = next - 1;
+            debug_log("[deallocate] merged %p (%zu bytes) and %p (%zu bytes) into %zu bytes (Thread %zu)\n",
+                      prev->address, prev->n_bytes, p, n_bytes, prev->n_bytes + n_bytes, thread_id());
+            prev->n_bytes += n_bytes;
+            if (next != m_freed_blocks.end() && prev->is_adjacent_to(*next)) { // closes the gap to the next block
+                prev->n_bytes += next->n_bytes;
+                m_freed_blocks.erase(next);
+            }
+            return;
+        }
+        if (next != m_freed_blocks.end() && freed_block.is_adjacent_to(*next)) { // is adjacent to the next block
+            debug_log("[deallocate] merged %p (%zu bytes) and %p (%zu bytes) into %zu bytes (Thread %zu)\n", p, n_bytes,
+                      next->address, next->n_bytes, next->n_bytes + n_bytes, thread_id());
+            next->n_bytes += n_bytes;
+            next->address = p;
+            return;
+        }
+    }
+    // no block to merge with, insert the freed block
+    debug_log("[deallocate] deallocated %zu bytes @ %p (Thread %zu Subpool %zu)\n", n_bytes, p, thread_id(),
+              m_subpools.size());
+    m_freed_blocks.emplace(next, freed_block);
+}
+
+/// @brief sort the buffered frees and merge them into the free list, coalescing, in one linear pass.
+/// @details the merge runs from the back into the grown free list, so nothing is overwritten before it is read.
+inline void pool_base_t::flush_deferred() const {
+    if (m_deferred_blocks.empty()) {
+        return;
+    }
+    debug_log("[deallocate] flushing %zu deferred blocks (Thread %zu)\n", m_deferred_blocks.size(), thread_id());
+    std::sort(m_deferred_blocks.begin(), m_deferred_blocks.end(), freed_block_t::less);
+    size_type n_old = m_freed_blocks.size();
+    m_freed_blocks.resize(n_old + m_deferred_blocks.size());
+    auto old_it = m_freed_blocks.begin() + static_cast<difference_type>(n_old);
+    auto new_it = m_deferred_blocks.end();
+    auto out = m_freed_blocks.end();
+    while (new_it != m_deferred_blocks.begin()) {
+        bool take_old = old_it != m_freed_blocks.begin() && freed_block_t::less(*(new_it - 1), *(old_it - 1));
+        freed_block_t block = take_old ? *--old_it : *--new_it;
+        if (out != m_freed_blocks.end() && block.is_adjacent_to(*out)) {
+            out->address = block.address;
+            out->n_bytes += block.n_bytes;
+        }
+        else {
+            *--out = block;
+        }
+    }
+    // the old blocks left are in place already, only the last one may touch the merged part
+    if (old_it != m_freed_blocks.begin() && out != m_freed_blocks.end() && (old_it - 1)->is_adjacent_to(*out)) {
+        --old_it;
+        out->address = old_it->address;
+        out->n_bytes += old_it->n_bytes;
+    }
+    m_freed_blocks.erase(old_it, out);
+    m_deferred_blocks.clear();
+}
 
-    if (m_freed_blocks.empty()) {
-        m_freed_blocks.emplace_back(freed_block_t{n_bytes, p});
+/// @brief switch between merging every free right away, buffering frees and ignoring them.
+inline void pool_base_t::set_mode(pool_mode mode) const {
+    if (mode != pool_mode::deferred) {
+        flush_deferred();
     }
     else {
-        freed_block_t freed_block{n_bytes, p};
-        // make sure the freed block is sorted by address in ascending order (in order to merge blocks)
-        auto insert_pos = std::lower_bound(m_freed_blocks.begin(), m_freed_blocks.end(), freed_block, freed_block_t::less);
-        QALLOC_IF_CONSTEXPR(merge) {
-            if (insert_pos != m_freed_blocks.end() && freed_block.is_adjacent_to(*insert_pos)) { // is adjacent to the next block
-                debug_log("[deallocate] merged %p (%zu bytes) and %p (%zu bytes) into %zu bytes (Thread %zu)\n", p, n_bytes,
-                        insert_pos->address, insert_pos->n_bytes, insert_pos->n_bytes + n_bytes, thread_id());
-                // merge with the next block
-                insert_pos->n_bytes += n_bytes;
-                insert_pos->address = p;
-
-                if (m_freed_blocks.size() > 1_z) {
-                    // iterate from the second block
-                    insert_pos = m_freed_blocks.begin() + 1;
-                    while (insert_pos != m_freed_blocks.end()) { // is adjacent to the previous block
-                        auto prev = insert_pos - 1;
-                        if (prev->is_adjacent_to(*insert_pos)) {
-                            debug_log("[deallocate] merged %p (%zu bytes) and %p (%zu bytes) into %zu bytes (Thread %zu)\n",
-                                    prev->address, prev->n_bytes, insert_pos->address, insert_pos->n_bytes,
-                                    prev->n_bytes + insert_pos->n_bytes, thread_id());
-                            // merge with the previous block
-                            prev->n_bytes += insert_pos->n_bytes;
-                            insert_pos = m_freed_blocks.erase(insert_pos);
-                        }
-                        else {
-                            ++insert_pos;
-                        }
-                    }
-                }
-                return;
+        m_deferred_blocks.reserve(deferred_buffer_size);
+    }
+    m_mode = mode;
+}
+
+inline pool_mode pool_base_t::mode() const noexcept {
+    return m_mode;
+}
+
+/// @brief save the position of the bump pointer, to give everything allocated after it back with rewind().
+inline pool_checkpoint_t pool_base_t::checkpoint() const noexcept {
+    return {size_cast(m_cur_subpool - m_subpools.data()), m_cur_subpool->pos, m_subpools.size()};
+}
+
+/// @brief give back everything allocated from the bump region since mark, marks nest like a stack.
+/// @details the current subpool and its position are restored, subpools added after the mark are
+/// released and freed blocks past the mark are dropped. Blocks reused from the free list, short lived
+/// blocks and large blocks allocated since the mark are not part of the bump region, deallocate them
+/// as usual, nurseries that existed at the mark are kept for them.
+inline void pool_base_t::rewind(const pool_checkpoint_t& mark) const {
+    QALLOC_ASSERT(mark.subpool_index < mark.n_subpools && mark.n_subpools <= m_subpools.size());
+    flush_deferred();
+    subpool_t& subpool = m_subpools[mark.subpool_index];
+    QALLOC_ASSERT(mark.pos >= subpool.begin && mark.pos <= subpool.end);
+    // nurseries keep no freed blocks, so every freed block after the mark subpool goes
+    auto first_after = m_subpools.begin() + static_cast<difference_type>(mark.subpool_index + 1);
+    auto last = m_freed_blocks.begin();
+    for (auto block : m_freed_blocks) {
+        if (std::any_of(first_after, m_subpools.end(), [&block](const subpool_t& after) {
+            return pointer::in_range(block.address, after.begin, after.end);
+        })) {
+            continue;
+        }
+        if (pointer::in_range(block.address, subpool.begin, subpool.end) && block.address + block.n_bytes > mark.pos) {
+            if (block.address >= mark.pos) {
+                continue;
+            }
+            block.n_bytes = size_cast(mark.pos - block.address); // merged with a block freed after the mark
+        }
+        *last++ = block;
+    }
+    m_freed_blocks.erase(last, m_freed_blocks.end());
+    for (size_type i = mark.n_subpools; i < m_subpools.size(); ++i) {
+        drop_subpool(i);
+    }
+    debug_log("[rewind] rewound to subpool %zu @ %p, %zu subpools released (Thread %zu)\n", mark.subpool_index + 1,
+              mark.pos, m_subpools.size() - mark.n_subpools, thread_id());
+    m_subpools.erase(m_subpools.begin() + static_cast<difference_type>(mark.n_subpools), m_subpools.end());
+    for (auto it = first_after; it != m_subpools.end(); ++it) {
+        if (!it->short_lived) { // kept by release(), empty at the mark
+            it->pos = pointer::remove_const(it->begin);
+        }
+    }
+    m_cur_subpool = &m_subpools[mark.subpool_index];
+    m_cur_subpool->pos = mark.pos;
+}
+
+/// @brief drop every allocation at once and start over from the first subpool, keeping the memory.
+/// @details takes O(number of subpools), every pointer into the subpools dangles afterwards.
+/// large blocks are not part of any subpool, they still have to be deallocated.
+/// a pool with an upstream keeps only its first subpool and gives the others back to the upstream.
+inline void pool_base_t::release() const {
+    if (m_upstream != nullptr) {
+        for (size_type i = 1; i < m_subpools.size(); ++i) {
+            drop_subpool(i);
+        }
+        m_subpools.erase(m_subpools.begin() + 1, m_subpools.end());
+    }
+    for (auto& subpool : m_subpools) {
+        subpool.pos = pointer::remove_const(subpool.begin);
+        subpool.n_freed = 0;
+    }
+    m_cur_subpool = &m_subpools.front();
+    while (m_cur_subpool->begin == nullptr && m_cur_subpool != &m_subpools.back()) { // released by gc
+        ++m_cur_subpool;
+    }
+    m_freed_blocks.clear();
+    m_deferred_blocks.clear();
+    m_padding_total = 0;
+    debug_log("[release] released %zu subpools (Thread %zu)\n", m_subpools.size(), thread_id());
+}
+
+inline byte_pointer pool_base_t::allocate_aligned(size_type n_bytes, size_type alignment) const {
+    QALLOC_ASSERT(n_bytes > 0);
+    QALLOC_ASSERT(alignment != 0 && (alignment & (alignment - 1)) == 0);
+    if (n_bytes >= QALLOC_LARGE_BLOCK_SIZE) { // deallocate() gives it back to the system
+        return allocate_large(n_bytes, alignment);
+    }
+    flush_deferred();
+    // try to find a freed block that still holds n_bytes after aligning its start
+    for (auto it = m_freed_blocks.begin(); it != m_freed_blocks.end(); ++it) {
+        byte_pointer address = pointer::align_up(it->address, alignment);
+        if (address + n_bytes > it->address + it->n_bytes) {
+            continue;
+        }
+        freed_block_t reused_block = *it;
+        m_freed_blocks.erase(it);
+        size_type size_before = size_cast(address - reused_block.address);
+        size_type size_after = reused_block.n_bytes - size_before - n_bytes;
+        // give back what is left on both sides
+        if (size_after != 0) {
+            free_block(address + n_bytes, size_after);
+        }
+        if (size_before != 0) {
+            free_block(reused_block.address, size_before);
+        }
+        debug_log("[allocate] reused freed block of %zu bytes for %zu bytes aligned to %zu @ %p (Thread %zu)\n",
+                  reused_block.n_bytes, n_bytes, alignment, address, thread_id());
+        return address;
+    }
+    if (!can_allocate(n_bytes + alignment - 1)) {
+        next_subpool(n_bytes + alignment - 1, std::max((n_bytes + alignment) * 2, m_cur_subpool->size * 2));
+    }
+    byte_pointer address = pointer::align_up(m_cur_subpool->pos, alignment);
+    if (address != m_cur_subpool->pos) { // the gap before the aligned address stays usable
+        free_block(m_cur_subpool->pos, size_cast(address - m_cur_subpool->pos));
+    }
+    m_cur_subpool->pos = address + n_bytes;
+    debug_log("[allocate] allocated %zu bytes aligned to %zu @ %p (Thread %zu Subpool %zu)\n", n_bytes, alignment,
+              address, thread_id(), m_subpools.size());
+    return address;
+}
+
+/// @brief allocate a block directly from the system, see deallocate_large().
+inline byte_pointer pool_base_t::allocate_large(size_type n_bytes, size_type alignment) const {
+    m_large_total += n_bytes;
+    if (alignment <= alignof(std::max_align_t)) {
+        debug_log("[allocate] allocated large block of %zu bytes (Thread %zu)\n", n_bytes, thread_id());
+        return static_cast<byte_pointer>(q_malloc(n_bytes));
+    }
+    // q_malloc can not align further, so align inside a bigger block and remember where it starts
+    size_type n_system = n_bytes + alignment - 1;
+    auto base = static_cast<byte_pointer>(q_malloc(n_system));
+    byte_pointer address = pointer::align_up(base, alignment);
+    m_aligned_large_blocks.emplace_back(large_block_t{address, base, n_system});
+    debug_log("[allocate] allocated large block of %zu bytes aligned to %zu @ %p (Thread %zu)\n",
+              n_bytes, alignment, address, thread_id());
+    return address;
+}
+
+/// @brief give a block of allocate_large() back to the system.
+inline void pool_base_t::deallocate_large(byte_pointer p, size_type n_bytes) const {
+    debug_log("[deallocate] released large block of %zu bytes @ %p (Thread %zu)\n", n_bytes, p, thread_id());
+    m_large_total -= n_bytes;
+    for (auto& block : m_aligned_large_blocks) {
+        if (block.address == p) {
+            internal::release_memory(block.base, block.n_bytes);
+            block = m_aligned_large_blocks.back();
+            m_aligned_large_blocks.pop_back();
+            return;
+        }
+    }
+    internal::release_memory(p, n_bytes);
+}
+
+constexpr size_type pool_base_t::isolated_size_of(size_type n_bytes) noexcept {
+    return (n_bytes + QALLOC_CACHE_LINE_SIZE - 1) & ~(size_type(QALLOC_CACHE_LINE_SIZE) - 1);
+}
+
+inline byte_pointer pool_base_t::allocate_isolated(size_type n_bytes) const {
+    // whole cache lines, so no other block can share a line with this one
+    size_type n_isolated = isolated_size_of(n_bytes);
+    byte_pointer address = allocate_aligned(n_isolated, QALLOC_CACHE_LINE_SIZE);
+    m_padding_total += n_isolated - n_bytes;
+    return address;
+}
+
+inline void pool_base_t::deallocate_isolated(byte_pointer p, size_type n_bytes) const {
+    QALLOC_ASSERT(pointer::is_aligned(p, QALLOC_CACHE_LINE_SIZE));
+    size_type n_isolated = isolated_size_of(n_bytes);
+    m_padding_total -= n_isolated - n_bytes;
+    if (n_isolated >= QALLOC_LARGE_BLOCK_SIZE) { // allocate_aligned() took it from the system
+        deallocate_large(p, n_isolated);
+        return;
+    }
+    free_block(p, n_isolated);
+}
+
+/// @brief allocate at least n_bytes, handing out remainders too small to be worth splitting off.
+/// @return the block and its usable size, to be passed to deallocate.
+inline allocation_result<byte_pointer> pool_base_t::allocate_at_least(size_type n_bytes) const {
+    QALLOC_ASSERT(n_bytes > 0);
+    if (n_bytes >= QALLOC_LARGE_BLOCK_SIZE) {
+        return {allocate(n_bytes), n_bytes};
+    }
+    flush_deferred();
+    auto it = std::find_if(
+            m_freed_blocks.begin(),
+            m_freed_blocks.end(),
+            [n_bytes](const freed_block_t& block) {
+                return block.n_bytes >= n_bytes;
             }
+    );
+    if (it != m_freed_blocks.end() && it->n_bytes - n_bytes < min_split_size && it->n_bytes < QALLOC_LARGE_BLOCK_SIZE) {
+        allocation_result<byte_pointer> result{it->address, it->n_bytes};
+        m_freed_blocks.erase(it);
+        debug_log("[allocate] reused whole freed block of %zu bytes for %zu bytes @ %p (Thread %zu)\n",
+                  result.count, n_bytes, result.ptr, thread_id());
+        return result;
+    }
+    if (it == m_freed_blocks.end() && can_allocate(n_bytes)) {
+        size_type n_left = size_cast(m_cur_subpool->end - m_cur_subpool->pos) - n_bytes;
+        if (n_left < min_split_size && n_bytes + n_left < QALLOC_LARGE_BLOCK_SIZE) { // take the tail of the subpool
+            allocation_result<byte_pointer> result{pointer::launder(m_cur_subpool->pos), n_bytes + n_left};
+            m_cur_subpool->pos += result.count;
+            return result;
+        }
+    }
+    return {allocate(n_bytes), n_bytes};
+}
+
+/// @brief grow a block in place, into the bump region or a freed block right after it.
+/// @return true if the block now holds n_bytes_new bytes, false if nothing changed.
+inline bool pool_base_t::try_expand(byte_pointer p, size_type n_bytes_old, size_type n_bytes_new) const {
+    QALLOC_ASSERT(p != nullptr);
+    QALLOC_ASSERT(n_bytes_old > 0);
+    if (n_bytes_new <= n_bytes_old) {
+        return true;
+    }
+    if (n_bytes_new >= QALLOC_LARGE_BLOCK_SIZE) { // large blocks are not part of any subpool
+        return false;
+    }
+    byte_pointer end = p + n_bytes_old;
+    size_type n_extra = n_bytes_new - n_bytes_old;
+    if (end == m_cur_subpool->pos) {
+        if (!can_allocate(n_extra)) {
+            return false;
+        }
+        m_cur_subpool->pos += n_extra;
+        debug_log("[expand] expanded %p from %zu to %zu bytes into the subpool (Thread %zu)\n", p, n_bytes_old,
+                  n_bytes_new, thread_id());
+        return true;
+    }
+    flush_deferred();
+    freed_block_t next{0, end};
+    auto it = std::lower_bound(m_freed_blocks.begin(), m_freed_blocks.end(), next, freed_block_t::less);
+    if (it == m_freed_blocks.end() || it->address != end || it->n_bytes < n_extra) {
+        return false;
+    }
+    it->address += n_extra;
+    it->n_bytes -= n_extra;
+    if (it->n_bytes == 0) {
+        m_freed_blocks.erase(it);
+    }
+    debug_log("[expand] expanded %p from %zu to %zu bytes into a freed block (Thread %zu)\n", p, n_bytes_old,
+              n_bytes_new, thread_id());
+    return true;
+}
+
+/// @brief give the tail of a block back to the pool.
+/// @return true if the block now holds n_bytes_new bytes, false if nothing changed.
+inline bool pool_base_t::shrink(byte_pointer p, size_type n_bytes_old, size_type n_bytes_new) const {
+    QALLOC_ASSERT(p != nullptr);
+    QALLOC_ASSERT(n_bytes_new > 0);
+    if (n_bytes_new >= n_bytes_old) {
+        return n_bytes_new == n_bytes_old;
+    }
+    if (n_bytes_old >= QALLOC_LARGE_BLOCK_SIZE) {
+        if (n_bytes_new < QALLOC_LARGE_BLOCK_SIZE) { // would be deallocated into a subpool it is not part of
+            return false;
+        }
+        m_large_total -= n_bytes_old - n_bytes_new;
+        return true;
+    }
+    byte_pointer tail = p + n_bytes_new;
+    if (p + n_bytes_old == m_cur_subpool->pos) { // the tail goes back to the bump region
+        m_cur_subpool->pos = tail;
+    }
+    else if (!free_to_nursery(tail, n_bytes_old - n_bytes_new)) {
+        free_block(tail, n_bytes_old - n_bytes_new);
+    }
+    debug_log("[shrink] shrank %p from %zu to %zu bytes (Thread %zu)\n", p, n_bytes_old, n_bytes_new, thread_id());
+    return true;
+}
+
+/// @brief allocate n_bytes as close as possible to hint, e.g. a tree node next to its parent.
+/// @details looks at the freed blocks around the hint in the subpool that owns it, and at the
+/// bump pointer when it is in the same subpool, the closest one wins, so a block on the page
+/// of the hint is preferred. Falls back to allocate() when the hint is not in the pool.
+inline byte_pointer pool_base_t::allocate_near(const_void_pointer hint, size_type n_bytes) const {
+    QALLOC_ASSERT(n_bytes > 0);
+    if (hint == nullptr || n_bytes >= QALLOC_LARGE_BLOCK_SIZE) {
+        return allocate(n_bytes);
+    }
+    auto owner = std::find_if(m_subpools.begin(), m_subpools.end(), [hint](const subpool_t& subpool) {
+        return pointer::in_range(hint, subpool.begin, subpool.end);
+    });
+    if (owner == m_subpools.end()) {
+        return allocate(n_bytes);
+    }
+    flush_deferred();
+    auto target = reinterpret_cast<std::uintptr_t>(hint);
+    auto distance_to = [target](const_byte_pointer address) {
+        auto value = reinterpret_cast<std::uintptr_t>(address);
+        return value > target ? value - target : target - value;
+    };
+    // the address a block would hand out: its head if it follows the hint, its tail otherwise
+    auto candidate_of = [hint, n_bytes](const freed_block_t& block) {
+        return block.address > hint ? block.address : block.address + block.n_bytes - n_bytes;
+    };
+    auto best = m_freed_blocks.end();
+    std::uintptr_t best_distance = ~std::uintptr_t(0);
+    auto consider = [&](std::vector<freed_block_t>::iterator it) {
+        if (it->n_bytes < n_bytes || !pointer::in_range(it->address, owner->begin, owner->end)) {
+            return;
+        }
+        std::uintptr_t distance = distance_to(candidate_of(*it));
+        if (distance < best_distance) {
+            best = it;
+            best_distance = distance;
+        }
+    };
+    auto next = std::lower_bound(m_freed_blocks.begin(), m_freed_blocks.end(),
+                                 freed_block_t{0, static_cast<byte_pointer>(const_cast<void_pointer>(hint))},
+                                 freed_block_t::less);
+    auto it = next;
+    for (size_type i = 0; i < near_scan_limit && it != m_freed_blocks.end(); ++i, ++it) {
+        consider(it);
+    }
+    it = next;
+    for (size_type i = 0; i < near_scan_limit && it != m_freed_blocks.begin(); ++i) {
+        consider(--it);
+    }
+    bool bump_is_near = &*owner == m_cur_subpool && can_allocate(n_bytes);
+    if (bump_is_near && distance_to(m_cur_subpool->pos) < best_distance) { // nothing freed is closer
+        byte_pointer address = pointer::launder(m_cur_subpool->pos);
+        m_cur_subpool->pos += n_bytes;
+        return address;
+    }
+    if (best == m_freed_blocks.end()) {
+        return allocate(n_bytes);
+    }
+    // take the part of the block next to the hint, the rest stays free
+    freed_block_t reused_block = *best;
+    byte_pointer address = candidate_of(reused_block);
+    m_freed_blocks.erase(best);
+    if (address != reused_block.address) {
+        free_block(reused_block.address, size_cast(address - reused_block.address));
+    }
+    size_type size_after = reused_block.n_bytes - n_bytes - size_cast(address - reused_block.address);
+    if (size_after != 0) {
+        free_block(address + n_bytes, size_after);
+    }
+    debug_log("[allocate] allocated %zu bytes @ %p, %zu bytes from %p (Thread %zu)\n", n_bytes, address,
+              size_type(best_distance), hint, thread_id());
+    return address;
+}
+
+/// @brief allocate count blocks of n_bytes in one pass over the free list and the bump region.
+/// @param out receives count pointers.
+inline void pool_base_t::allocate_batch(size_type n_bytes, size_type count, byte_pointer* out) const {
+    QALLOC_ASSERT(n_bytes > 0);
+    QALLOC_ASSERT(out != nullptr || count == 0);
+    if (n_bytes >= QALLOC_LARGE_BLOCK_SIZE) {
+        for (size_type i = 0; i < count; ++i) {
+            out[i] = allocate(n_bytes);
+        }
+        return;
+    }
+    flush_deferred();
+    size_type i = 0;
+    // carve runs from the freed blocks, emptied ones are erased once at the end
+    for (auto& block : m_freed_blocks) {
+        while (block.n_bytes >= n_bytes && i < count) {
+            out[i++] = block.address;
+            block.address += n_bytes;
+            block.n_bytes -= n_bytes;
+        }
+        if (i == count) {
+            break;
+        }
+    }
+    m_freed_blocks.erase(
+            std::remove_if(m_freed_blocks.begin(), m_freed_blocks.end(), [](const freed_block_t& block) {
+                return block.n_bytes == 0;
+            }),
+            m_freed_blocks.end()
+    );
+    size_type n_left = count - i;
+    if (n_left == 0) {
+        return;
+    }
+    // and the rest from one contiguous run of the bump region
+    if (!can_allocate(n_left * n_bytes)) {
+        next_subpool(n_left * n_bytes, std::max(n_left * n_bytes * 2, m_cur_subpool->size * 2));
+    }
+    byte_pointer address = pointer::launder(m_cur_subpool->pos);
+    for (; i < count; ++i, address += n_bytes) {
+        out[i] = address;
+    }
+    m_cur_subpool->pos = address;
+    debug_log("[allocate] allocated %zu blocks of %zu bytes (Thread %zu Subpool %zu)\n", count, n_bytes, thread_id(),
+              m_subpools.size());
+}
+
+/// @brief deallocate count blocks of n_bytes, sorting and merging them into the free list once.
+inline void pool_base_t::deallocate_batch(const byte_pointer* blocks, size_type count, size_type n_bytes) const {
+    QALLOC_ASSERT(n_bytes > 0);
+    QALLOC_ASSERT(blocks != nullptr || count == 0);
+    if (n_bytes >= QALLOC_LARGE_BLOCK_SIZE) {
+        for (size_type i = 0; i < count; ++i) {
+            deallocate(blocks[i], n_bytes);
         }
-        // no block to merge with, insert the freed block
-        debug_log("[deallocate] deallocated %zu bytes @ %p (Thread %zu Subpool %zu)\n", n_bytes, p, thread_id(),
-                  m_subpools.size());
-        m_freed_blocks.emplace(insert_pos, freed_block);
+        return;
     }
+    if (m_mode == pool_mode::monotonic) {
+        return;
+    }
+    for (size_type i = 0; i < count; ++i) { // merged like buffered frees, together with the ones already there
+        QALLOC_ASSERT(is_valid(blocks[i]));
+        if (!free_to_nursery(blocks[i], n_bytes)) {
+            m_deferred_blocks.emplace_back(freed_block_t{n_bytes, blocks[i]});
+        }
+    }
+    flush_deferred();
+    debug_log("[deallocate] deallocated %zu blocks of %zu bytes (Thread %zu)\n", count, n_bytes, thread_id());
 }
 
 inline void pool_base_t::add_subpool(size_type n_bytes) const {
     debug_log("[allocate] adding new subpool with size %zu (Thread %zu Subpool %zu)\n", n_bytes, thread_id(),
               m_subpools.size());
+    free_tail();
+    // add new subpool
+    m_subpools.emplace_back(new_subpool(n_bytes));
+    m_cur_subpool = &m_subpools.back();
+    m_pool_total += n_bytes;
+}
+
+/// @brief move on to the next subpool kept by release() that can hold n_bytes_needed,
+/// or add a new subpool of n_bytes_new when there is none.
+inline void pool_base_t::next_subpool(size_type n_bytes_needed, size_type n_bytes_new) const {
+    free_tail();
+    for (subpool_t* next = m_cur_subpool + 1; next != m_subpools.data() + m_subpools.size(); ++next) {
+        if (next->begin == nullptr || next->short_lived) { // released by gc or a nursery
+            continue;
+        }
+        m_cur_subpool = next; // only after release()
+        if (can_allocate(n_bytes_needed)) {
+            debug_log("[allocate] continuing in kept subpool %zu (Thread %zu)\n",
+                      size_cast(m_cur_subpool - m_subpools.data()) + 1, thread_id());
+            return;
+        }
+        free_tail();
+    }
+    add_subpool(n_bytes_new);
+}
+
+/// @brief mark the space left in the current subpool as freed before leaving it.
+inline void pool_base_t::free_tail() const {
     // if there is space left in current subpool
     if (m_cur_subpool->end != m_cur_subpool->pos) {
-        debug_log("[allocate] subpool %zu has %zu bytes left @ %p (Thread %zu)\n", m_subpools.size(),
-                  m_cur_subpool->end - m_cur_subpool->pos, m_cur_subpool->pos, thread_id());
+        debug_log("[allocate] subpool %zu has %zu bytes left @ %p (Thread %zu)\n",
+                  size_cast(m_cur_subpool - m_subpools.data()) + 1, m_cur_subpool->end - m_cur_subpool->pos,
+                  m_cur_subpool->pos, thread_id());
         // mark it as freed
-        deallocate<false>(m_cur_subpool->pos, size_cast(m_cur_subpool->end - m_cur_subpool->pos));
+        free_block(m_cur_subpool->pos, size_cast(m_cur_subpool->end - m_cur_subpool->pos));
+        m_cur_subpool->pos = pointer::remove_const(m_cur_subpool->end);
     }
-    // add new subpool
+}
+
+/// @brief add a subpool for short lived allocations, the current subpool stays current.
+inline void pool_base_t::add_nursery(size_type n_bytes) const {
+    size_type cur_index = size_cast(m_cur_subpool - m_subpools.data());
     m_subpools.emplace_back(new_subpool(n_bytes));
-    m_cur_subpool = &m_subpools.back();
+    m_subpools.back().short_lived = true;
+    m_cur_subpool = &m_subpools[cur_index];
+    m_nursery = m_subpools.size() - 1;
     m_pool_total += n_bytes;
+    ++m_n_nurseries;
+    debug_log("[allocate] added nursery subpool %zu with size %zu (Thread %zu)\n", m_nursery + 1, n_bytes, thread_id());
+}
+
+/// @brief count a deallocation in the nursery holding p, so its holes are never reused by normal allocations.
+/// @return false when p is not in a nursery.
+inline bool pool_base_t::free_to_nursery(byte_pointer p, size_type n_bytes) const {
+    if (m_n_nurseries == 0) {
+        return false;
+    }
+    for (auto& subpool : m_subpools) {
+        if (subpool.short_lived && pointer::in_range(p, subpool.begin, subpool.end)) {
+            subpool.n_freed += n_bytes;
+            return true;
+        }
+    }
+    return false;
+}
+
+/// @brief give a subpool back and leave an empty slot, so the indices of the others stay valid.
+inline void pool_base_t::drop_subpool(size_type index) const {
+    subpool_t& subpool = m_subpools[index];
+    if (subpool.begin == nullptr || subpool.begin == m_inline_buffer) { // released already, or owned by the caller
+        return;
+    }
+    release_subpool(subpool);
+    m_pool_total -= subpool.size;
+    if (subpool.short_lived) {
+        --m_n_nurseries;
+    }
+    if (index == m_nursery) {
+        m_nursery = no_nursery;
+    }
+    subpool = {};
 }
 
 constexpr bool pool_base_t::can_allocate(size_type n_bytes) const noexcept {
     return m_cur_subpool->pos + n_bytes <= m_cur_subpool->end;
 }
 
+inline size_type pool_base_t::padding_bytes() const noexcept {
+    return m_padding_total;
+}
+
+inline const pool_base_t* pool_base_t::upstream() const noexcept {
+    return m_upstream;
+}
+
+inline size_type pool_base_t::large_bytes() const noexcept {
+    return m_large_total;
+}
+
 size_type pool_base_t::bytes_used() const noexcept {
     size_t bytes_used = m_pool_total;
     for (const auto& block : m_freed_blocks) {
         bytes_used -= block.n_bytes;
     }
-    bytes_used -= size_cast(m_cur_subpool->end - m_cur_subpool->pos);
+    for (const auto& block : m_deferred_blocks) {
+        bytes_used -= block.n_bytes;
+    }
+    for (const auto& subpool : m_subpools) {
+        // the ones after the current subpool are only there after release()
+        if (&subpool >= m_cur_subpool || subpool.short_lived) {
+            bytes_used -= size_cast(subpool.end - subpool.pos);
+        }
+        bytes_used -= subpool.n_freed;
+    }
     return bytes_used;
 }
 
@@ -220,9 +928,16 @@ inline void pool_base_t::print_info(bool usage_only) const {
     else {
         QALLOC_PRINTF("\n");
     }
+    if (m_large_total != 0_z) {
+        QALLOC_PRINTF("  Large blocks: %zu bytes\n", m_large_total);
+    }
+    if (m_padding_total != 0_z) {
+        QALLOC_PRINTF("  Cache line padding: %zu bytes\n", m_padding_total);
+    }
     if (usage_only) {
         return;
     }
+    flush_deferred();
     QALLOC_PRINTF("  Subpools: \n");
     int i = 1;
     for (const auto& pool : m_subpools) {
@@ -243,11 +958,10 @@ inline void pool_base_t::print_info(bool usage_only) const {
     for (const auto& block : m_freed_blocks) {
         auto allocated_block = block_info_t::at(block.address);
         QALLOC_PRINTF("    %p: %zu bytes\n", block.address, block.n_bytes);
-        if (size_cast(allocated_block->subpool_index) <= m_subpools.size()) {
-            QALLOC_PRINTF("      Subpool: %zu, type: ", size_cast(allocated_block->subpool_index) + 1);
-            if (allocated_block->is_valid()) {
-                auto type_name = demangled_type_name_of(allocated_block->type_info->name());
-                QALLOC_PRINTF("%s\n", type_name.c_str());
+        if (size_type(allocated_block->subpool_index) <= m_subpools.size()) {
+            QALLOC_PRINTF("      Subpool: %zu, type: ", size_type(allocated_block->subpool_index) + 1);
+            if (internal::type_registry().contains(allocated_block->type_id)) {
+                QALLOC_PRINTF("%s\n", internal::type_registry().name_of(allocated_block->type_id).c_str());
             }
             else {
                 QALLOC_PRINTF("N/A\n");
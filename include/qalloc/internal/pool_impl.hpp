@@ -20,61 +20,147 @@
 #ifndef QALLOC_POOL_IMPL_HPP
 #define QALLOC_POOL_IMPL_HPP
 
-#include <algorithm> // std::remove_if
+#include <algorithm> // std::remove_if, std::lower_bound
 #include <stdexcept> // std::bad_alloc
 #include <iostream> // std::cout, std::endl
 #include <qalloc/internal/pool_base.hpp>
 #include <qalloc/internal/debug_log.hpp>
 #include <qalloc/internal/memory.hpp>
+#include <qalloc/internal/deallocation_service.hpp>
 #include <qalloc/internal/defs.hpp>
 
 QALLOC_BEGIN
 
+/// @details the header is header_size_of<T>() bytes, 4 for small types. An over-aligned T gets an
+/// aligned block, the block_info_t is at the end of the header so block_info_t::of() finds it for any type.
 template <class T>
 byte_pointer pool_t::detailed_allocate(size_type n_bytes_requested) const {
-    byte_pointer ptr = pool_base_t::allocate(n_bytes_requested + sizeof(block_info_t));
-    new (pointer::launder(ptr)) block_info_t{&typeid(T), index_type(m_subpools.size() - 1)};
-    return ptr + sizeof(block_info_t);
+    constexpr size_type alignment = internal::alignment_of<T>::value;
+    constexpr size_type header_size = block_info_t::header_size_of<T>();
+    byte_pointer ptr = alignment > alignof(std::max_align_t)
+            ? pool_base_t::allocate_aligned(n_bytes_requested + header_size, alignment)
+            : pool_base_t::allocate(n_bytes_requested + header_size);
+    return add_header<T>(ptr);
 }
 
 template <class T>
 void pool_t::detailed_deallocate(byte_pointer p, size_type n_bytes_requested) const {
     QALLOC_DEBUG_STATEMENT(
         auto& block = *block_info_t::of(p);
-        QALLOC_ASSERT(size_cast(block.subpool_index) < m_subpools.size());
-        QALLOC_ASSERT(*block.type_info == typeid(T));
+        QALLOC_ASSERT(block.subpool_index == block_info_t::unknown_subpool || block.subpool_index < m_subpools.size());
+        QALLOC_ASSERT(block.type_id == type_id_of<T>());
     )
-    pool_base_t::deallocate(pointer::launder(p - sizeof(block_info_t)), n_bytes_requested + sizeof(block_info_t));
+    constexpr size_type header_size = block_info_t::header_size_of<T>();
+    pool_base_t::deallocate(pointer::launder(p - header_size), n_bytes_requested + header_size);
 }
 
+template <class T>
+byte_pointer pool_t::detailed_allocate_near(const_void_pointer hint, size_type n_bytes_requested) const {
+    QALLOC_IF_CONSTEXPR(internal::alignment_of<T>::value > alignof(std::max_align_t)) { // no aligned placement by hint
+        return detailed_allocate<T>(n_bytes_requested);
+    }
+    return add_header<T>(pool_base_t::allocate_near(hint, n_bytes_requested + block_info_t::header_size_of<T>()));
+}
+
+template <class T>
+allocation_result<byte_pointer> pool_t::detailed_allocate_at_least(size_type n_bytes_requested) const {
+    QALLOC_IF_CONSTEXPR(internal::alignment_of<T>::value > alignof(std::max_align_t)) { // exactly what was asked for
+        return {detailed_allocate<T>(n_bytes_requested), n_bytes_requested};
+    }
+    constexpr size_type header_size = block_info_t::header_size_of<T>();
+    allocation_result<byte_pointer> result = pool_base_t::allocate_at_least(n_bytes_requested + header_size);
+    return {add_header<T>(result.ptr), result.count - header_size};
+}
+
+template <class T>
+void pool_t::detailed_allocate_batch(size_type n_bytes_requested, size_type count, byte_pointer* out) const {
+    QALLOC_IF_CONSTEXPR(internal::alignment_of<T>::value > alignof(std::max_align_t)) { // one aligned block at a time
+        for (size_type i = 0; i < count; ++i) {
+            out[i] = detailed_allocate<T>(n_bytes_requested);
+        }
+        return;
+    }
+    pool_base_t::allocate_batch(n_bytes_requested + block_info_t::header_size_of<T>(), count, out);
+    for (size_type i = 0; i < count; ++i) {
+        out[i] = add_header<T>(out[i]);
+    }
+}
+
+/// @note blocks is rewritten to point at the block headers.
+template <class T>
+void pool_t::detailed_deallocate_batch(byte_pointer* blocks, size_type count, size_type n_bytes_requested) const {
+    constexpr size_type header_size = block_info_t::header_size_of<T>();
+    for (size_type i = 0; i < count; ++i) {
+        QALLOC_ASSERT(block_info_t::of(blocks[i])->type_id == type_id_of<T>());
+        blocks[i] = pointer::launder(blocks[i] - header_size);
+    }
+    pool_base_t::deallocate_batch(blocks, count, n_bytes_requested + header_size);
+}
+
+/// @brief write the block_info_t of a T into the header starting at block.
+/// @return the address of the object.
+template <class T>
+byte_pointer pool_t::add_header(byte_pointer block) const {
+    byte_pointer p = block + block_info_t::header_size_of<T>();
+    new (block_info_t::of(p)) block_info_t(block_info_t::make<T>(m_subpools.size() - 1));
+    return p;
+}
+
+inline scope::scope(const pool_base_t& pool) noexcept
+    : m_pool(pool), m_mark(pool.checkpoint()) {}
+
+inline scope::~scope() {
+    m_pool.rewind(m_mark);
+}
+
+inline const pool_checkpoint_t& scope::mark() const noexcept {
+    return m_mark;
+}
+
+/// @brief release every subpool, but the current one, whose allocations are all deallocated.
+/// @details a subpool is empty when the freed blocks at its beginning cover everything bumped from it,
+/// a nursery when its counted deallocations do.
+/// @return number of bytes given back.
 QALLOC_MAYBE_UNUSED
-size_type pool_t::gc() const { // TODO: fix this, not gc triggers
+size_type pool_t::gc() const {
     size_type memory_freed = 0;
-    for (auto it = m_freed_blocks.begin(); it != m_freed_blocks.end();) {
-        auto& block = *it;
-        block_info_t* block_info = block_info_t::at(block.address);
-        if (size_cast(block_info->subpool_index) >= m_subpools.size()) {
-            // the header of the block maybe overwritten by a reuse of block
+    flush_deferred();
+    for (size_type i = 0; i < m_subpools.size(); ++i) {
+        subpool_t& owner = m_subpools[i];
+        if (&owner == m_cur_subpool || owner.begin == nullptr || owner.begin == m_inline_buffer) {
             continue;
         }
-        subpool_t& owner = m_subpools[size_cast(block_info->subpool_index)];
-        if (block.n_bytes == owner.size) { // whole subpool is freed
-            // To ensure the subpool index in all blocks are valid
-            // do not erase the released subpool
-            debug_log("[gc]: subpool %zu released (%zu bytes)\n", size_cast(block_info->subpool_index) + 1, owner.size);
-            memory_freed += owner.size;
-            // release the subpool
-            q_free(pointer::remove_const(owner.begin)); // TODO: reuse the memory
-            // update total pool size
-            this->m_pool_total -= owner.size;
-            // reset the subpool to ZEROs/NULLs
-            owner = {};
-            // remove the freed block from the list
-            it = m_freed_blocks.erase(it);
+        if (owner.short_lived) { // no free list, its deallocations are only counted
+            if (owner.n_freed < size_cast(owner.pos - owner.begin)) {
+                continue;
+            }
         }
         else {
-            ++it;
+            auto first = std::lower_bound(m_freed_blocks.begin(), m_freed_blocks.end(),
+                                          freed_block_t{0, pointer::remove_const(owner.begin)}, freed_block_t::less);
+            auto last = first;
+            size_type n_covered = 0;
+            while (last != m_freed_blocks.end() && last->address == owner.begin + n_covered && n_covered < owner.size) {
+                n_covered += last->n_bytes;
+                ++last;
+            }
+            if (n_covered < size_cast(owner.pos - owner.begin)) { // something is still allocated
+                continue;
+            }
+            if (n_covered > owner.size) { // merged with the next subpool, which happened to be adjacent in memory
+                auto overhang = last - 1;
+                size_type n_over = n_covered - owner.size;
+                overhang->address = overhang->address + overhang->n_bytes - n_over;
+                overhang->n_bytes = n_over;
+                --last;
+            }
+            m_freed_blocks.erase(first, last);
         }
+        // To ensure the subpool index in all blocks are valid
+        // do not erase the released subpool
+        debug_log("[gc]: subpool %zu released (%zu bytes)\n", i + 1, owner.size);
+        memory_freed += owner.size;
+        drop_subpool(i);
     }
     return memory_freed;
 }
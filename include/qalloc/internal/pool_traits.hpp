@@ -0,0 +1,219 @@
+// Copyright 2022 yusing. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/// @file qalloc/internal/pool_traits.hpp
+/// @brief qalloc per type pool configuration header file.
+/// @author yusing
+/// @date 2022-07-14
+
+#ifndef QALLOC_POOL_TRAITS_HPP
+#define QALLOC_POOL_TRAITS_HPP
+
+#include <cstddef>     // std::ptrdiff_t
+#include <type_traits> // std::is_same, std::integral_constant
+#include <qalloc/internal/defs.hpp>
+#include <qalloc/internal/pointer.hpp>
+#include <qalloc/internal/block.hpp>
+#include <qalloc/internal/basic_pool.hpp>
+
+QALLOC_BEGIN
+
+/// @brief compile time pool configuration of @b T, specialize it to tune a type.
+/// @details every member configures the pool of traits_allocator<T>. qalloc::allocator
+/// only takes @b initial_size, for the first subpool of the thread pool of @b T, its
+/// pools are pool_t whatever the policies are. E.g. a hot type can get a large prefaulted pool:
+/// @code
+/// template <> struct qalloc::pool_traits<order_t> : qalloc::pool_traits<void> {
+///     static constexpr qalloc::size_type initial_size = 1 << 20;
+///     using page_provider = qalloc::prefaulted_page_provider_t;
+/// };
+/// std::vector<order_t, qalloc::traits_allocator<order_t>> orders;
+/// @endcode
+/// @tparam T The type of the object to allocate.
+template <typename T>
+struct pool_traits {
+    /// size of the first subpool of the thread pool of @b T
+    static constexpr size_type initial_size = sizeof(T) * 16;
+    /// alignment the pool has to guarantee, checked against the free list policy
+    static constexpr size_type alignment = alignof(T);
+    /// whether traits_allocator stores a block_info_t with the type before every block
+    static constexpr bool detailed = false;
+
+    using free_list_policy = size_class_free_list_t;
+    using growth_policy    = geometric_growth_t;
+    using page_provider    = malloc_page_provider_t;
+    using threading_policy = single_threaded_t; // anything else gets one process wide pool instead of one per thread
+}; // struct pool_traits
+
+/// @brief defaults to derive specializations from.
+template <>
+struct pool_traits<void> {
+    static constexpr size_type initial_size = 4096;
+    static constexpr size_type alignment = 1;
+    static constexpr bool detailed = false;
+
+    using free_list_policy = size_class_free_list_t;
+    using growth_policy    = geometric_growth_t;
+    using page_provider    = malloc_page_provider_t;
+    using threading_policy = single_threaded_t;
+}; // struct pool_traits<void>
+
+/// @brief basic_pool type selected by pool_traits<T>.
+template <typename T>
+using traits_pool_t = basic_pool<
+        typename pool_traits<T>::free_list_policy,
+        typename pool_traits<T>::growth_policy,
+        typename pool_traits<T>::page_provider,
+        typename pool_traits<T>::threading_policy
+>;
+
+/// @brief qalloc allocator class configured by pool_traits<T> at compile time.
+/// @details rebinding from the default pool goes to the pool configured for the
+/// rebound type, so container nodes follow the traits of the node type. A pool
+/// given to the constructor is kept when the rebound type has the same pool type.
+/// @tparam T The type of the object to allocate.
+template <typename T>
+class traits_allocator {
+public:
+    using value_type       = T;
+    using pointer          = T*;
+    using const_pointer    = const T*;
+    using reference        = T&;
+    using const_reference  = const T&;
+    using size_type        = qalloc::size_type;
+    using difference_type  = std::ptrdiff_t;
+    using is_always_equal  = std::false_type;
+    using pool_type        = traits_pool_t<T>;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap            = std::true_type;
+
+    template <typename U>
+    class rebind {
+    public:
+        using other = traits_allocator<U>;
+    };
+
+    traits_allocator() noexcept;
+    explicit traits_allocator(const pool_type& pool) noexcept;
+    template <typename U>
+    traits_allocator(const traits_allocator<U>&) noexcept; // NOLINT(google-explicit-constructor)
+
+    pointer allocate(size_type n_elements);
+    void deallocate(pointer p, size_type n_elements);
+
+    QALLOC_NODISCARD
+    constexpr const pool_type* pool() const noexcept;
+private:
+    static constexpr size_type header_size = pool_traits<T>::detailed ? block_info_t::header_size_of<T>() : 0;
+
+    static_assert(pool_traits<T>::alignment <= alignof(std::max_align_t),
+                  "subpools are only aligned to alignof(std::max_align_t)");
+    static_assert(pool_traits<T>::alignment <= pool_type::free_list_policy::alignment,
+                  "the free list policy does not guarantee the alignment of the type");
+
+    const pool_type* m_pool_ptr;
+}; // class traits_allocator
+
+QALLOC_END
+
+QALLOC_INTERNAL_BEGIN
+/// @internal
+template <typename T>
+inline const traits_pool_t<T>& get_traits_pool(std::true_type /* thread local */) {
+    // never destroyed, like the pools of get_pool(), containers may outlive the thread
+    thread_local const traits_pool_t<T>* g_traits_pool = new traits_pool_t<T>(pool_traits<T>::initial_size);
+    return *g_traits_pool;
+}
+
+/// @internal
+template <typename T>
+inline const traits_pool_t<T>& get_traits_pool(std::false_type /* thread local */) {
+    static const traits_pool_t<T> g_traits_pool(pool_traits<T>::initial_size);
+    return g_traits_pool;
+}
+
+/// @internal
+/// @brief get the pool configured by pool_traits<T>, per thread when single threaded, per process otherwise.
+template <typename T>
+inline const traits_pool_t<T>& get_traits_pool() {
+    return get_traits_pool<T>(std::is_same<typename pool_traits<T>::threading_policy, single_threaded_t>());
+}
+
+/// @internal
+/// @brief pool for a traits_allocator of @b T rebound from one of @b U using @b p_pool, like rebound_pool().
+template <typename T, typename U>
+inline const traits_pool_t<T>* rebound_traits_pool(const traits_pool_t<U>* p_pool, std::true_type /* same pool type */) {
+    return p_pool == &get_traits_pool<U>() ? &get_traits_pool<T>() : p_pool;
+}
+
+/// @internal
+template <typename T, typename U>
+inline const traits_pool_t<T>* rebound_traits_pool(const traits_pool_t<U>*, std::false_type /* same pool type */) {
+    return &get_traits_pool<T>();
+}
+QALLOC_INTERNAL_END
+
+QALLOC_BEGIN
+
+template <typename T> traits_allocator<T>::
+traits_allocator() noexcept
+    : m_pool_ptr(&internal::get_traits_pool<T>()) {}
+
+template <typename T> traits_allocator<T>::
+traits_allocator(const pool_type& pool) noexcept
+    : m_pool_ptr(&pool) {}
+
+template <typename T> template <typename U> traits_allocator<T>::
+traits_allocator(const traits_allocator<U>& other) noexcept
+    : m_pool_ptr(internal::rebound_traits_pool<T, U>(other.pool(), std::is_same<traits_pool_t<T>, traits_pool_t<U>>())) {}
+
+template <typename T> typename traits_allocator<T>::pointer traits_allocator<T>::
+allocate(size_type n_elements) {
+    QALLOC_ASSERT(n_elements > 0);
+    byte_pointer p = m_pool_ptr->allocate(n_elements * sizeof(T) + header_size);
+    QALLOC_IF_CONSTEXPR(pool_traits<T>::detailed) {
+        new (block_info_t::of(p + header_size)) block_info_t(block_info_t::make<T>(0));
+    }
+    return reinterpret_cast<pointer>(p + header_size);
+}
+
+template <typename T> void traits_allocator<T>::
+deallocate(pointer p, size_type n_elements) {
+    QALLOC_ASSERT(n_elements > 0);
+    if (p == nullptr) return;
+    byte_pointer block = qalloc::pointer::launder(reinterpret_cast<byte_pointer>(p) - header_size);
+    QALLOC_IF_CONSTEXPR(pool_traits<T>::detailed) {
+        QALLOC_ASSERT(block_info_t::of(p)->type_id == type_id_of<T>());
+    }
+    m_pool_ptr->deallocate(block, n_elements * sizeof(T) + header_size);
+}
+
+template <typename T>
+constexpr const typename traits_allocator<T>::pool_type* traits_allocator<T>::pool() const noexcept {
+    return m_pool_ptr;
+}
+
+template <typename T, typename U>
+bool operator==(const traits_allocator<T>& lhs, const traits_allocator<U>& rhs) noexcept {
+    return lhs.pool() == traits_allocator<T>(rhs).pool();
+}
+
+template <typename T, typename U>
+bool operator!=(const traits_allocator<T>& lhs, const traits_allocator<U>& rhs) noexcept {
+    return !(lhs == rhs);
+}
+
+QALLOC_END
+
+#endif // QALLOC_POOL_TRAITS_HPP
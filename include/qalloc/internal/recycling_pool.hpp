@@ -0,0 +1,181 @@
+// Copyright 2022 yusing. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/// @file qalloc/internal/recycling_pool.hpp
+/// @brief qalloc pool recycling constructed objects header file.
+/// @author yusing
+/// @date 2022-07-17
+
+#ifndef QALLOC_RECYCLING_POOL_HPP
+#define QALLOC_RECYCLING_POOL_HPP
+
+#include <memory>  // std::unique_ptr
+#include <new>     // placement new
+#include <utility> // std::forward
+#include <vector>
+#include <qalloc/internal/defs.hpp>
+#include <qalloc/internal/pointer.hpp>
+#include <qalloc/internal/allocator.hpp>
+#include <qalloc/internal/allocator_impl.hpp>
+
+QALLOC_BEGIN
+
+/// @brief default reset hook of recycling_pool, calls @b obj.reset().
+struct call_reset_t {
+    template <typename T>
+    void operator()(T& obj) const {
+        obj.reset();
+    }
+}; // struct call_reset_t
+
+/// @brief pool handing back previously constructed objects of type @b T.
+/// @details a released object is reset by @b Reset and kept instead of destroyed,
+/// so the capacity of its nested containers and strings survives for the next
+/// acquire(). At most max_retained objects are kept, the others are destroyed.
+/// Memory comes from the pool of @b T of the thread that created the pool, so
+/// objects must be released on that thread, see get_recycling_pool().
+/// @tparam T The type of the objects.
+/// @tparam Reset functor taking a @b T& and bringing it back to a reusable state.
+template <typename T, typename Reset = call_reset_t>
+class recycling_pool {
+public:
+    /// @brief deleter giving the object back to its recycling pool.
+    class deleter {
+    public:
+        explicit deleter(recycling_pool* pool = nullptr) noexcept : m_pool(pool) {}
+        void operator()(T* p) const { m_pool->release(p); }
+    private:
+        recycling_pool* m_pool;
+    }; // class deleter
+
+    using unique_pointer = std::unique_ptr<T, deleter>;
+
+    explicit recycling_pool(size_type max_retained = 64, Reset reset = Reset());
+    recycling_pool(const recycling_pool&) = delete;
+    recycling_pool& operator=(const recycling_pool&) = delete;
+    ~recycling_pool();
+
+    template <typename... Args>
+    T* acquire(Args&&... args);
+    template <typename... Args>
+    unique_pointer acquire_unique(Args&&... args);
+    void release(T* p);
+    void clear();
+
+    QALLOC_NODISCARD
+    size_type n_retained() const noexcept;
+    QALLOC_NODISCARD
+    size_type max_retained() const noexcept;
+    void set_max_retained(size_type max_retained);
+private:
+    void destroy(T* p);
+
+    simple_allocator<T> m_allocator;
+    std::vector<T*>     m_retained;
+    size_type           m_max_retained;
+    Reset               m_reset;
+}; // class recycling_pool
+
+/// @brief get the calling thread's recycling pool of @b T.
+template <typename T, typename Reset = call_reset_t>
+inline recycling_pool<T, Reset>& get_recycling_pool() {
+    thread_local recycling_pool<T, Reset> g_recycling_pool;
+    return g_recycling_pool;
+}
+
+template <typename T, typename Reset> recycling_pool<T, Reset>::
+recycling_pool(size_type max_retained, Reset reset)
+    : m_allocator(), m_retained(), m_max_retained(max_retained), m_reset(std::move(reset)) {
+    m_retained.reserve(max_retained);
+}
+
+template <typename T, typename Reset> recycling_pool<T, Reset>::
+~recycling_pool() {
+    clear();
+}
+
+/// @brief get a retained object, or construct one from args when none is left.
+/// @note args are ignored for a recycled object, it is in the state @b Reset left it in.
+template <typename T, typename Reset> template <typename... Args>
+T* recycling_pool<T, Reset>::acquire(Args&&... args) {
+    if (!m_retained.empty()) {
+        T* p = m_retained.back();
+        m_retained.pop_back();
+        return p;
+    }
+    T* p = m_allocator.allocate(1);
+    try {
+        return new (static_cast<void_pointer>(p)) T(std::forward<Args>(args)...);
+    }
+    catch (...) {
+        m_allocator.deallocate(p, 1);
+        throw;
+    }
+}
+
+template <typename T, typename Reset> template <typename... Args>
+typename recycling_pool<T, Reset>::unique_pointer recycling_pool<T, Reset>::acquire_unique(Args&&... args) {
+    return unique_pointer(acquire(std::forward<Args>(args)...), deleter(this));
+}
+
+/// @brief reset the object and keep it for the next acquire(), or destroy it when the pool is full.
+template <typename T, typename Reset>
+void recycling_pool<T, Reset>::release(T* p) {
+    if (p == nullptr) return;
+    if (m_retained.size() >= m_max_retained) {
+        destroy(p);
+        return;
+    }
+    m_reset(*p);
+    m_retained.push_back(p);
+}
+
+/// @brief destroy every retained object.
+template <typename T, typename Reset>
+void recycling_pool<T, Reset>::clear() {
+    for (T* p : m_retained) {
+        destroy(p);
+    }
+    m_retained.clear();
+}
+
+template <typename T, typename Reset>
+size_type recycling_pool<T, Reset>::n_retained() const noexcept {
+    return m_retained.size();
+}
+
+template <typename T, typename Reset>
+size_type recycling_pool<T, Reset>::max_retained() const noexcept {
+    return m_max_retained;
+}
+
+/// @brief change the bound, objects above it are destroyed.
+template <typename T, typename Reset>
+void recycling_pool<T, Reset>::set_max_retained(size_type max_retained) {
+    while (m_retained.size() > max_retained) {
+        destroy(m_retained.back());
+        m_retained.pop_back();
+    }
+    m_max_retained = max_retained;
+}
+
+template <typename T, typename Reset>
+void recycling_pool<T, Reset>::destroy(T* p) {
+    p->~T();
+    m_allocator.deallocate(p, 1);
+}
+
+QALLOC_END
+
+#endif // QALLOC_RECYCLING_POOL_HPP
@@ -0,0 +1,329 @@
+// Copyright 2022 yusing. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/// @file qalloc/internal/shared_pool.hpp
+/// @brief qalloc thread safe shared pool class header file.
+/// @author yusing
+/// @date 2022-07-10
+
+#ifndef QALLOC_SHARED_POOL_HPP
+#define QALLOC_SHARED_POOL_HPP
+
+#include <algorithm> // std::min
+#include <atomic>  // std::atomic
+#include <cstdint> // std::uint64_t, std::uintptr_t
+#include <mutex>   // std::mutex, std::lock_guard
+#include <qalloc/internal/defs.hpp>
+#include <qalloc/internal/pointer.hpp>
+#include <qalloc/internal/debug_log.hpp>
+#include <qalloc/internal/pool.hpp>
+
+QALLOC_BEGIN
+
+/// @brief lock-free free list of equally sized blocks (Treiber stack).
+///
+/// The head packs a version tag next to the pointer, every successful push or
+/// pop bumps it, so a head that was popped and pushed back in between fails the
+/// compare-exchange instead of corrupting the list (ABA).
+class tagged_free_list_t {
+public:
+    struct node_t {
+        node_t* next;
+    }; // struct node_t
+
+    tagged_free_list_t() noexcept = default;
+    tagged_free_list_t(const tagged_free_list_t&) = delete;
+    tagged_free_list_t& operator=(const tagged_free_list_t&) = delete;
+
+    void push(node_t* first, node_t* last) noexcept;
+    node_t* pop() noexcept;
+private:
+    using head_type = std::uint64_t;
+
+    // user space addresses fit in 48 bits on 64-bit targets, the rest holds the tag
+    static constexpr unsigned pointer_bits = sizeof(std::uintptr_t) == 4 ? 32u : 48u;
+    static constexpr head_type pointer_mask = (head_type(1) << pointer_bits) - 1;
+
+    QALLOC_NODISCARD
+    static node_t* pointer_of(head_type head) noexcept;
+    QALLOC_NODISCARD
+    static head_type pack(node_t* p, head_type tag) noexcept;
+    QALLOC_NODISCARD
+    static constexpr head_type next_tag_of(head_type head) noexcept;
+
+    std::atomic<head_type> m_head{0};
+}; // class tagged_free_list_t
+
+/// @brief qalloc thread safe pool class.
+///
+/// Blocks up to @b max_small_size bytes are served by one lock-free free list per
+/// size class, the free lists are refilled in chunks from a mutex guarded pool_t,
+/// which also serves the larger blocks. Memory of the small size classes is never
+/// given back before the pool is destroyed, so a stale free list node can always
+/// be read safely.
+class shared_pool_t {
+public:
+    static constexpr size_type min_small_size = 16;
+    static constexpr size_type n_size_classes = 6; // 16, 32, 64, 128, 256, 512
+    static constexpr size_type max_small_size = min_small_size << (n_size_classes - 1);
+
+    explicit shared_pool_t(size_type chunk_size = 16384_z);
+    shared_pool_t(const shared_pool_t&) = delete;
+    shared_pool_t(shared_pool_t&&) = delete;
+    shared_pool_t& operator=(const shared_pool_t&) = delete;
+    shared_pool_t& operator=(shared_pool_t&&) = delete;
+    ~shared_pool_t() = default;
+
+    byte_pointer allocate(size_type n_bytes) const;
+    void deallocate(byte_pointer p, size_type n_bytes) const;
+
+    size_type pool_size() const;
+private:
+    using node_t = tagged_free_list_t::node_t;
+
+    QALLOC_NODISCARD
+    static constexpr size_type size_class_of(size_type n_bytes) noexcept;
+    QALLOC_NODISCARD
+    static constexpr size_type block_size_of(size_type size_class) noexcept;
+    QALLOC_NODISCARD
+    static constexpr size_type round_up(size_type n_bytes) noexcept;
+
+    node_t* refill(size_type size_class) const;
+
+    struct alignas(QALLOC_CACHE_LINE_SIZE) size_class_t {
+        mutable tagged_free_list_t free_list;
+    }; // struct size_class_t
+
+    size_class_t       m_size_classes[n_size_classes];
+    size_type          m_chunk_size;
+    mutable std::mutex m_backing_mutex;
+    pool_t             m_backing; // guarded by m_backing_mutex
+}; // class shared_pool_t
+
+/// @brief qalloc allocator class backed by a thread safe shared pool.
+/// @tparam T The type of the object to allocate.
+template <typename T>
+class shared_allocator {
+public:
+    using value_type       = T;
+    using pointer          = T*;
+    using const_pointer    = const T*;
+    using reference        = T&;
+    using const_reference  = const T&;
+    using size_type        = qalloc::size_type;
+    using difference_type  = std::ptrdiff_t;
+    using is_always_equal  = std::false_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap            = std::true_type;
+
+    template <typename U>
+    class rebind {
+    public:
+        using other = shared_allocator<U>;
+    };
+
+    shared_allocator() noexcept;
+    explicit shared_allocator(const shared_pool_t*) noexcept;
+    template <typename U>
+    shared_allocator(const shared_allocator<U>&) noexcept; // NOLINT(google-explicit-constructor)
+
+    pointer allocate(size_type n_elements);
+    void deallocate(pointer p, size_type n_elements);
+
+    QALLOC_NODISCARD
+    constexpr const shared_pool_t* pool() const noexcept;
+private:
+    const shared_pool_t* m_pool_ptr;
+}; // class shared_allocator
+
+QALLOC_END
+
+QALLOC_INTERNAL_BEGIN
+/// @internal
+/// @brief get the process wide shared pool.
+inline const shared_pool_t* get_shared_pool() {
+    static const shared_pool_t g_shared_pool;
+    return &g_shared_pool;
+}
+QALLOC_INTERNAL_END
+
+QALLOC_BEGIN
+
+inline tagged_free_list_t::node_t* tagged_free_list_t::pointer_of(head_type head) noexcept {
+    return reinterpret_cast<node_t*>(static_cast<std::uintptr_t>(head & pointer_mask));
+}
+
+inline tagged_free_list_t::head_type tagged_free_list_t::pack(node_t* p, head_type tag) noexcept {
+    // masked rather than asserted, pop() may pack a garbage next pointer that loses the exchange anyway
+    auto address = static_cast<head_type>(reinterpret_cast<std::uintptr_t>(p));
+    return (tag << pointer_bits) | (address & pointer_mask);
+}
+
+constexpr tagged_free_list_t::head_type tagged_free_list_t::next_tag_of(head_type head) noexcept {
+    return (head >> pointer_bits) + 1;
+}
+
+inline void tagged_free_list_t::push(node_t* first, node_t* last) noexcept {
+    QALLOC_ASSERT((static_cast<head_type>(reinterpret_cast<std::uintptr_t>(first)) & ~pointer_mask) == 0);
+    head_type head = m_head.load(std::memory_order_relaxed);
+    head_type desired;
+    do {
+        last->next = pointer_of(head);
+        desired = pack(first, next_tag_of(head));
+    } while (!m_head.compare_exchange_weak(head, desired, std::memory_order_release, std::memory_order_relaxed));
+}
+
+inline tagged_free_list_t::node_t* tagged_free_list_t::pop() noexcept {
+    head_type head = m_head.load(std::memory_order_acquire);
+    for (;;) {
+        node_t* node = pointer_of(head);
+        if (node == nullptr) {
+            return nullptr;
+        }
+        // node may already be popped and reused by another thread, the read
+        // value is then garbage but the tag makes the exchange below fail
+        node_t* next = node->next;
+        if (m_head.compare_exchange_weak(head, pack(next, next_tag_of(head)),
+                                         std::memory_order_acquire, std::memory_order_acquire)) {
+            return node;
+        }
+    }
+}
+
+inline shared_pool_t::shared_pool_t(size_type chunk_size)
+    : m_size_classes  (),
+      m_chunk_size    (round_up(chunk_size)),
+      m_backing_mutex (),
+      m_backing       (m_chunk_size)
+{
+    QALLOC_ASSERT(chunk_size >= max_small_size);
+}
+
+constexpr size_type shared_pool_t::size_class_of(size_type n_bytes) noexcept {
+    size_type size_class = 0;
+    size_type block_size = min_small_size;
+    while (block_size < n_bytes) {
+        block_size <<= 1;
+        ++size_class;
+    }
+    return size_class;
+}
+
+constexpr size_type shared_pool_t::block_size_of(size_type size_class) noexcept {
+    return min_small_size << size_class;
+}
+
+constexpr size_type shared_pool_t::round_up(size_type n_bytes) noexcept {
+    // keeps every block handed out by m_backing aligned to min_small_size
+    return (n_bytes + min_small_size - 1) & ~(min_small_size - 1);
+}
+
+inline shared_pool_t::node_t* shared_pool_t::refill(size_type size_class) const {
+    size_type block_size = block_size_of(size_class);
+    // below the large block size a chunk lives in a subpool of m_backing, so it is freed with the pool
+    size_type n_blocks = std::min(m_chunk_size, size_type(QALLOC_LARGE_BLOCK_SIZE) - 1) / block_size;
+    byte_pointer chunk;
+    {
+        std::lock_guard<std::mutex> lock_guard(m_backing_mutex);
+        chunk = m_backing.allocate_aligned(n_blocks * block_size, min_small_size);
+    }
+    debug_log("[shared] refilled size class %zu with %zu blocks @ %p\n", block_size, n_blocks, chunk);
+    // keep the first block for the caller and publish the rest at once
+    if (n_blocks > 1_z) {
+        auto* first = reinterpret_cast<node_t*>(chunk + block_size);
+        node_t* last = first;
+        for (size_type i = 2; i < n_blocks; ++i) {
+            auto* node = reinterpret_cast<node_t*>(chunk + i * block_size);
+            last->next = node;
+            last = node;
+        }
+        m_size_classes[size_class].free_list.push(first, last);
+    }
+    return reinterpret_cast<node_t*>(chunk);
+}
+
+inline byte_pointer shared_pool_t::allocate(size_type n_bytes) const {
+    QALLOC_ASSERT(n_bytes > 0);
+    if (n_bytes > max_small_size) {
+        std::lock_guard<std::mutex> lock_guard(m_backing_mutex);
+        return m_backing.allocate(round_up(n_bytes));
+    }
+    size_type size_class = size_class_of(n_bytes);
+    node_t* node = m_size_classes[size_class].free_list.pop();
+    if (node == nullptr) {
+        node = refill(size_class);
+    }
+    return reinterpret_cast<byte_pointer>(node);
+}
+
+inline void shared_pool_t::deallocate(byte_pointer p, size_type n_bytes) const {
+    QALLOC_ASSERT(p != nullptr);
+    QALLOC_ASSERT(n_bytes > 0);
+    if (n_bytes > max_small_size) {
+        std::lock_guard<std::mutex> lock_guard(m_backing_mutex);
+        m_backing.deallocate(p, round_up(n_bytes));
+        return;
+    }
+    auto* node = reinterpret_cast<node_t*>(p);
+    m_size_classes[size_class_of(n_bytes)].free_list.push(node, node);
+}
+
+inline size_type shared_pool_t::pool_size() const {
+    std::lock_guard<std::mutex> lock_guard(m_backing_mutex);
+    return m_backing.pool_size();
+}
+
+template <typename T> shared_allocator<T>::
+shared_allocator() noexcept
+    : m_pool_ptr(internal::get_shared_pool()) {}
+
+template <typename T> shared_allocator<T>::
+shared_allocator(const shared_pool_t* p_pool) noexcept
+    : m_pool_ptr(p_pool) {}
+
+template <typename T> template <typename U> shared_allocator<T>::
+shared_allocator(const shared_allocator<U>& other) noexcept
+    : m_pool_ptr(other.pool()) {}
+
+template <typename T> typename shared_allocator<T>::pointer shared_allocator<T>::
+allocate(size_type n_elements) {
+    QALLOC_ASSERT(n_elements > 0);
+    return reinterpret_cast<pointer>(m_pool_ptr->allocate(n_elements * sizeof(T)));
+}
+
+template <typename T> void shared_allocator<T>::
+deallocate(pointer p, size_type n_elements) {
+    QALLOC_ASSERT(n_elements > 0);
+    if (p == nullptr) return;
+    m_pool_ptr->deallocate(qalloc::pointer::launder(reinterpret_cast<byte_pointer>(p)), n_elements * sizeof(T));
+}
+
+template <typename T>
+constexpr const shared_pool_t* shared_allocator<T>::pool() const noexcept {
+    return m_pool_ptr;
+}
+
+template <typename T, typename U>
+constexpr bool operator==(const shared_allocator<T>& lhs, const shared_allocator<U>& rhs) noexcept {
+    return lhs.pool() == rhs.pool();
+}
+
+template <typename T, typename U>
+constexpr bool operator!=(const shared_allocator<T>& lhs, const shared_allocator<U>& rhs) noexcept {
+    return !(lhs == rhs);
+}
+
+QALLOC_END
+
+#endif // QALLOC_SHARED_POOL_HPP
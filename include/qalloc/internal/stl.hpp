@@ -102,6 +102,40 @@ using deque = std::deque<T, TAllocator>;
 
 } // namespace simple
 
+/// @brief STL container types with a zero size allocator bound to the calling thread's pool.
+namespace stateless {
+
+template <typename T, typename TAllocator = qalloc::stateless_allocator<T>>
+using vector = std::vector<T, TAllocator>;
+
+template <typename TKey, typename TValue, typename TLess = std::less<TKey>, typename TAllocator = qalloc::stateless_allocator<std::pair<const TKey, TValue>>>
+using map = std::map<TKey, TValue, TLess, TAllocator>;
+
+template <typename TKey, typename TValue, typename THash = std::hash<TKey>, typename TEqualTo = std::equal_to<TKey>, typename TAllocator = qalloc::stateless_allocator<std::pair<const TKey, TValue>>>
+using unordered_map = std::unordered_map<TKey, TValue, THash, TEqualTo, TAllocator>;
+
+template <typename T, typename TLess = std::less<T>, typename TAllocator = qalloc::stateless_allocator<T>>
+using set = std::set<T, TLess, TAllocator>;
+
+template <typename T, typename THash = std::hash<T>, typename TEqualTo = std::equal_to<T>, typename TAllocator = qalloc::stateless_allocator<T>>
+using unordered_set = std::unordered_set<T, THash, TEqualTo, TAllocator>;
+
+template <typename TChar = char, typename TCharTraits = std::char_traits<TChar>, typename TAllocator = qalloc::stateless_allocator<TChar>>
+using basic_string = std::basic_string<TChar, TCharTraits, TAllocator>;
+using string = qalloc::stateless::basic_string<char>;
+
+template <typename TChar = char, typename TCharTraits = std::char_traits<TChar>, typename TAllocator = qalloc::stateless_allocator<TChar>>
+using basic_stringstream = std::basic_stringstream<TChar, TCharTraits, TAllocator>;
+using stringstream = qalloc::stateless::basic_stringstream<char>;
+
+template <typename T, typename TAllocator = qalloc::stateless_allocator<T>>
+using list = std::list<T, TAllocator>;
+
+template <typename T, typename TAllocator = qalloc::stateless_allocator<T>>
+using deque = std::deque<T, TAllocator>;
+
+} // namespace stateless
+
 using namespace stl;
 
 QALLOC_END
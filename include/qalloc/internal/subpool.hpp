@@ -30,6 +30,8 @@ struct subpool_t { // use byte pointer for easier pointer arithmetics
     const_byte_pointer  end;
     byte_pointer        pos;
     size_type           size;
+    bool                short_lived = false; // holds only allocations hinted as short lived
+    size_type           n_freed = 0;         // bytes deallocated from a short lived subpool, which has no free list
 }; // struct subpool_t
 QALLOC_END
 
@@ -20,20 +20,20 @@
 #ifndef QALLOC_TYPE_INFO_HPP
 #define QALLOC_TYPE_INFO_HPP
 
+#include <string>
 #include <typeinfo>
-#include <unordered_map>
-#include <cstring> // std::strlen, std::memcpy
 #include <qalloc/internal/defs.hpp>
 #include <qalloc/internal/pointer.hpp>
 #include <qalloc/internal/block.hpp>
+#include <qalloc/internal/type_registry.hpp>
 #include <qalloc/internal/stl.hpp>
 
 QALLOC_BEGIN
 /// @brief get type info of pointer.
 /// @param p pointer allocated from qalloc pool.
 /// @return type info of pointer.
-constexpr const std::type_info& type_of(void_pointer p) {
-    return *block_info_t::of(p)->type_info;
+inline const std::type_info& type_of(void_pointer p) {
+    return internal::type_registry().type_info_of(block_info_t::of(p)->type_id);
 }
 
 /// @brief get raw type name of object in pointer.
@@ -47,25 +47,14 @@ inline const char* type_name_of(void_pointer p) {
 /// @param mangled_name mangled type name.
 /// @return @b std::string of demangled type name.
 std::string demangled_type_name_of(const char* mangled_name) {
-#if QALLOC_CXA_DEMANGLE
-    int status;
-    char* demangled_name = abi::__cxa_demangle(mangled_name, nullptr, nullptr, &status);
-    if (status != 0) {
-        throw std::runtime_error("Cannot demangle type name");
-    }
-    std::string result(demangled_name);
-    std::free(demangled_name);
-    return result;
-#else
-    return {mangled_name};
-#endif
+    return internal::demangle(mangled_name);
 }
 
 /// @brief get demangled type name of object in pointer.
 /// @param p pointer allocated from qalloc pool.
-/// @return @b std::string of demangled type name of object in pointer.
-std::string demangled_type_name_of(void_pointer p) {
-    return demangled_type_name_of(type_name_of(p));
+/// @return demangled type name of object in pointer, interned by the type registry.
+const std::string& demangled_type_name_of(void_pointer p) {
+    return internal::type_registry().name_of(block_info_t::of(p)->type_id);
 }
 
 /// @brief cast pointer to another type with type check.
@@ -74,7 +63,7 @@ std::string demangled_type_name_of(void_pointer p) {
 /// @return a reference to pointer of type @b T.
 template <typename T> QALLOC_MAYBE_UNUSED
 T& safe_cast(void_pointer p) {
-    if(type_of(p) != typeid(T)) {
+    if (block_info_t::of(p)->type_id != type_id_of<T>()) {
         throw std::bad_cast();
     }
     return *static_cast<T*>(p);
@@ -0,0 +1,130 @@
+// Copyright 2022 yusing. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/// @file qalloc/internal/type_registry.hpp
+/// @brief qalloc runtime type registry header file.
+/// @author yusing
+/// @date 2022-07-15
+
+#ifndef QALLOC_TYPE_REGISTRY_HPP
+#define QALLOC_TYPE_REGISTRY_HPP
+
+#include <cstdint>    // std::uint16_t
+#include <cstdlib>    // std::free
+#include <deque>
+#include <limits>     // std::numeric_limits
+#include <mutex>      // std::mutex, std::lock_guard
+#include <stdexcept>  // std::runtime_error, std::length_error
+#include <string>
+#include <typeindex>  // std::type_index
+#include <typeinfo>
+#include <unordered_map>
+#include <qalloc/internal/defs.hpp>
+#include <qalloc/internal/pointer.hpp>
+
+QALLOC_BEGIN
+/// @brief dense id of a type registered in the type registry, 0 is no type.
+using type_id_t = std::uint16_t;
+QALLOC_END
+
+QALLOC_INTERNAL_BEGIN
+/// @internal
+/// @brief get demangled type name from mangled type name.
+inline std::string demangle(const char* mangled_name) {
+#if QALLOC_CXA_DEMANGLE
+    int status;
+    char* demangled_name = abi::__cxa_demangle(mangled_name, nullptr, nullptr, &status);
+    if (status != 0) {
+        throw std::runtime_error("Cannot demangle type name");
+    }
+    std::string result(demangled_name);
+    std::free(demangled_name);
+    return result;
+#else
+    return {mangled_name};
+#endif
+}
+
+/// @internal
+/// @brief process wide registry handing out small ids to types, names are demangled once.
+class type_registry_t {
+public:
+    static constexpr size_type max_types = std::numeric_limits<type_id_t>::max();
+
+    type_registry_t() {
+        m_types.push_back(nullptr); // id 0 stays unused, it marks blocks without a type
+        m_names.emplace_back("N/A");
+    }
+
+    type_id_t register_type(const std::type_info& type_info) {
+        std::lock_guard<std::mutex> lock_guard(m_mutex);
+        auto it = m_ids.find(std::type_index(type_info));
+        if (it != m_ids.end()) {
+            return it->second;
+        }
+        if (m_types.size() > max_types) {
+            throw std::length_error("qalloc type registry is full");
+        }
+        auto id = static_cast<type_id_t>(m_types.size());
+        m_types.push_back(&type_info);
+        m_names.push_back(demangle(type_info.name()));
+        m_ids.emplace(std::type_index(type_info), id);
+        return id;
+    }
+
+    QALLOC_NODISCARD
+    bool contains(type_id_t id) const {
+        std::lock_guard<std::mutex> lock_guard(m_mutex);
+        return id != 0 && id < m_types.size();
+    }
+
+    QALLOC_NODISCARD
+    const std::type_info& type_info_of(type_id_t id) const {
+        std::lock_guard<std::mutex> lock_guard(m_mutex);
+        if (id == 0 || id >= m_types.size()) {
+            throw std::bad_typeid();
+        }
+        return *m_types[id];
+    }
+
+    /// @note the name is never moved, the reference stays valid.
+    QALLOC_NODISCARD
+    const std::string& name_of(type_id_t id) const {
+        std::lock_guard<std::mutex> lock_guard(m_mutex);
+        return id < m_names.size() ? m_names[id] : m_names.front();
+    }
+private:
+    mutable std::mutex                                m_mutex;
+    std::deque<const std::type_info*>                 m_types;
+    std::deque<std::string>                           m_names; // deque keeps references stable
+    std::unordered_map<std::type_index, type_id_t>    m_ids;
+}; // class type_registry_t
+
+/// @internal
+inline type_registry_t& type_registry() {
+    static type_registry_t g_type_registry;
+    return g_type_registry;
+}
+QALLOC_INTERNAL_END
+
+QALLOC_BEGIN
+/// @brief get the registry id of @b T, registering it on first use.
+template <typename T>
+inline type_id_t type_id_of() {
+    static const type_id_t g_type_id = internal::type_registry().register_type(typeid(T));
+    return g_type_id;
+}
+QALLOC_END
+
+#endif // QALLOC_TYPE_REGISTRY_HPP
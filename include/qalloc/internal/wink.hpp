@@ -0,0 +1,283 @@
+// Copyright 2022 yusing. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/// @file qalloc/internal/wink.hpp
+/// @brief qalloc container scoped pool with wink out destruction header file.
+/// @author yusing
+/// @date 2022-07-16
+
+#ifndef QALLOC_WINK_HPP
+#define QALLOC_WINK_HPP
+
+#include <cstddef>       // std::ptrdiff_t
+#include <functional>    // std::less, std::hash, std::equal_to
+#include <map>
+#include <new>           // placement new
+#include <set>
+#include <type_traits>   // std::is_trivially_destructible
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>       // std::pair
+#include <vector>
+#include <qalloc/internal/defs.hpp>
+#include <qalloc/internal/pointer.hpp>
+#include <qalloc/internal/pool.hpp>
+#include <qalloc/internal/pool_impl.hpp>
+#include <qalloc/internal/pool_base_impl.hpp>
+
+QALLOC_BEGIN
+
+/// @brief pool dedicated to one container, everything in it can be dropped at once.
+/// @details large blocks bypass the subpools, so they are tracked here to be dropped too.
+class wink_pool_t : public pool_t {
+public:
+    using pool_t::pool_t;
+    wink_pool_t(const wink_pool_t&) = delete;
+    wink_pool_t& operator=(const wink_pool_t&) = delete;
+    ~wink_pool_t() override;
+
+    byte_pointer allocate(size_type n_bytes) const;
+    void deallocate(byte_pointer p, size_type n_bytes) const;
+    void wink_out() const;
+private:
+    mutable std::vector<freed_block_t> m_large_blocks; // live blocks of at least QALLOC_LARGE_BLOCK_SIZE
+}; // class wink_pool_t
+
+/// @brief qalloc allocator class bound to a wink_pool_t.
+/// @details allocators of different pools never compare equal and do not
+/// propagate, a container moved out of its winkable copies its elements.
+/// @tparam T The type of the object to allocate.
+template <typename T>
+class wink_allocator {
+public:
+    using value_type       = T;
+    using pointer          = T*;
+    using const_pointer    = const T*;
+    using reference        = T&;
+    using const_reference  = const T&;
+    using size_type        = qalloc::size_type;
+    using difference_type  = std::ptrdiff_t;
+    using is_always_equal  = std::false_type;
+
+    template <typename U>
+    class rebind {
+    public:
+        using other = wink_allocator<U>;
+    };
+
+    explicit wink_allocator(const wink_pool_t* pool) noexcept;
+    template <typename U>
+    wink_allocator(const wink_allocator<U>& other) noexcept; // NOLINT(google-explicit-constructor)
+
+    pointer allocate(size_type n_elements);
+    void deallocate(pointer p, size_type n_elements);
+
+    QALLOC_NODISCARD
+    constexpr const wink_pool_t* pool() const noexcept;
+private:
+    const wink_pool_t* m_pool_ptr;
+}; // class wink_allocator
+
+/// @brief a container that owns its pool and can be destroyed without visiting its nodes.
+/// @code
+/// qalloc::wink::map<int, int> m;
+/// for (int i = 0; i < 1000000; ++i) (*m)[i] = i;
+/// m.wink_out(); // O(number of subpools), m is empty and usable again
+/// @endcode
+/// @tparam Container container type using wink_allocator.
+template <typename Container>
+class winkable {
+public:
+    using container_type = Container;
+    using allocator_type = typename Container::allocator_type;
+
+    explicit winkable(size_type initial_size = 4096);
+    winkable(const winkable&) = delete;
+    winkable& operator=(const winkable&) = delete;
+    ~winkable();
+
+    Container& operator*() noexcept;
+    const Container& operator*() const noexcept;
+    Container* operator->() noexcept;
+    const Container* operator->() const noexcept;
+    Container& get() noexcept;
+    const Container& get() const noexcept;
+    QALLOC_NODISCARD
+    const wink_pool_t& pool() const noexcept;
+
+    void wink_out();
+private:
+    static_assert(std::is_same<allocator_type,
+                  wink_allocator<typename allocator_type::value_type>>::value,
+                  "the container has to use wink_allocator");
+
+    wink_pool_t m_pool;
+    alignas(Container) unsigned char m_storage[sizeof(Container)];
+}; // class winkable
+
+inline wink_pool_t::~wink_pool_t() {
+    for (const auto& block : m_large_blocks) {
+        pool_t::deallocate(block.address, block.n_bytes);
+    }
+}
+
+inline byte_pointer wink_pool_t::allocate(size_type n_bytes) const {
+    byte_pointer p = pool_t::allocate(n_bytes);
+    if (n_bytes >= QALLOC_LARGE_BLOCK_SIZE) {
+        m_large_blocks.emplace_back(freed_block_t{n_bytes, p});
+    }
+    return p;
+}
+
+inline void wink_pool_t::deallocate(byte_pointer p, size_type n_bytes) const {
+    if (n_bytes >= QALLOC_LARGE_BLOCK_SIZE) {
+        for (auto& block : m_large_blocks) {
+            if (block.address == p) {
+                block = m_large_blocks.back();
+                m_large_blocks.pop_back();
+                break;
+            }
+        }
+    }
+    pool_t::deallocate(p, n_bytes);
+}
+
+/// @brief drop every allocation without visiting it, subpools are kept for reuse and large blocks freed.
+/// @warning every pointer into the pool dangles afterwards.
+inline void wink_pool_t::wink_out() const {
+    for (const auto& block : m_large_blocks) {
+        pool_t::deallocate(block.address, block.n_bytes);
+    }
+    m_large_blocks.clear();
+    release();
+}
+
+template <typename T> wink_allocator<T>::
+wink_allocator(const wink_pool_t* pool) noexcept
+    : m_pool_ptr(pool) {}
+
+template <typename T> template <typename U> wink_allocator<T>::
+wink_allocator(const wink_allocator<U>& other) noexcept
+    : m_pool_ptr(other.pool()) {}
+
+template <typename T> typename wink_allocator<T>::pointer wink_allocator<T>::
+allocate(size_type n_elements) {
+    QALLOC_ASSERT(n_elements > 0);
+    return reinterpret_cast<pointer>(m_pool_ptr->allocate(n_elements * sizeof(T)));
+}
+
+template <typename T> void wink_allocator<T>::
+deallocate(pointer p, size_type n_elements) {
+    QALLOC_ASSERT(n_elements > 0);
+    if (p == nullptr) return;
+    m_pool_ptr->deallocate(reinterpret_cast<byte_pointer>(p), n_elements * sizeof(T));
+}
+
+template <typename T>
+constexpr const wink_pool_t* wink_allocator<T>::pool() const noexcept {
+    return m_pool_ptr;
+}
+
+template <typename T, typename U>
+constexpr bool operator==(const wink_allocator<T>& lhs, const wink_allocator<U>& rhs) noexcept {
+    return lhs.pool() == rhs.pool();
+}
+
+template <typename T, typename U>
+constexpr bool operator!=(const wink_allocator<T>& lhs, const wink_allocator<U>& rhs) noexcept {
+    return !(lhs == rhs);
+}
+
+template <typename Container> winkable<Container>::
+winkable(size_type initial_size)
+    : m_pool(initial_size) {
+    new (m_storage) Container(allocator_type(&m_pool));
+}
+
+/// @details containers of trivially destructible elements are winked out, the others destroyed as usual.
+template <typename Container> winkable<Container>::
+~winkable() {
+    QALLOC_IF_CONSTEXPR(!std::is_trivially_destructible<typename Container::value_type>::value) {
+        get().~Container();
+    }
+}
+
+template <typename Container>
+Container& winkable<Container>::operator*() noexcept {
+    return get();
+}
+
+template <typename Container>
+const Container& winkable<Container>::operator*() const noexcept {
+    return get();
+}
+
+template <typename Container>
+Container* winkable<Container>::operator->() noexcept {
+    return &get();
+}
+
+template <typename Container>
+const Container* winkable<Container>::operator->() const noexcept {
+    return &get();
+}
+
+template <typename Container>
+Container& winkable<Container>::get() noexcept {
+    return *pointer::launder(reinterpret_cast<Container*>(m_storage));
+}
+
+template <typename Container>
+const Container& winkable<Container>::get() const noexcept {
+    return *pointer::launder(reinterpret_cast<const Container*>(m_storage));
+}
+
+template <typename Container>
+const wink_pool_t& winkable<Container>::pool() const noexcept {
+    return m_pool;
+}
+
+/// @brief empty the container by dropping its pool, without destroying or deallocating any node.
+/// @details the old container object is abandoned in place and a new empty one is constructed over it.
+template <typename Container>
+void winkable<Container>::wink_out() {
+    static_assert(std::is_trivially_destructible<typename Container::value_type>::value,
+                  "only containers of trivially destructible elements can be winked out");
+    m_pool.wink_out();
+    new (m_storage) Container(allocator_type(&m_pool));
+}
+
+/// @brief container types on a pool of their own that can be winked out.
+namespace wink {
+
+template <typename T>
+using vector = winkable<std::vector<T, wink_allocator<T>>>;
+
+template <typename TKey, typename TValue, typename TLess = std::less<TKey>>
+using map = winkable<std::map<TKey, TValue, TLess, wink_allocator<std::pair<const TKey, TValue>>>>;
+
+template <typename TKey, typename TValue, typename THash = std::hash<TKey>, typename TEqualTo = std::equal_to<TKey>>
+using unordered_map = winkable<std::unordered_map<TKey, TValue, THash, TEqualTo, wink_allocator<std::pair<const TKey, TValue>>>>;
+
+template <typename T, typename TLess = std::less<T>>
+using set = winkable<std::set<T, TLess, wink_allocator<T>>>;
+
+template <typename T, typename THash = std::hash<T>, typename TEqualTo = std::equal_to<T>>
+using unordered_set = winkable<std::unordered_set<T, THash, TEqualTo, wink_allocator<T>>>;
+
+} // namespace wink
+
+QALLOC_END
+
+#endif // QALLOC_WINK_HPP
@@ -25,7 +25,18 @@
 #include <qalloc/internal/pool_base_impl.hpp>
 #include <qalloc/internal/allocator.hpp>
 #include <qalloc/internal/allocator_impl.hpp>
+#include <qalloc/internal/type_registry.hpp>
 #include <qalloc/internal/type_info.hpp>
 #include <qalloc/internal/stl.hpp>
+#include <qalloc/internal/percpu_pool.hpp>
+#include <qalloc/internal/shared_pool.hpp>
+#include <qalloc/internal/epoch.hpp>
+#include <qalloc/internal/deallocation_service.hpp>
+#include <qalloc/internal/basic_pool.hpp>
+#include <qalloc/internal/pool_traits.hpp>
+#include <qalloc/internal/wink.hpp>
+#include <qalloc/internal/inline_pool.hpp>
+#include <qalloc/internal/object_pool.hpp>
+#include <qalloc/internal/recycling_pool.hpp>
 
-#endif // QALLOC_QALLOC_HPP
\ No newline at end of file
+#endif // QALLOC_QALLOC_HPP
\ No newline at end of file
@@ -18,9 +18,13 @@
 /// @author yusing
 /// @date 2022-07-02
 
+#include <algorithm>
+#include <random>
 #include <vector>
 #include <string>
 #include <unordered_map>
+#include <map>
+#include <list>
 #include <qalloc/qalloc.hpp>
 #include <benchmark/benchmark.h>
 
@@ -114,6 +118,14 @@ static void QAlloc_String_Creation(benchmark::State& state) {
     }
 }
 
+static void QAlloc_Stateless_String_Creation(benchmark::State& state) {
+    qalloc::stateless::string s;
+    for (auto _ : state) {
+        qalloc::stateless::string copy(s);
+        (void)copy;
+    }
+}
+
 static void Std_String_Append_Reset(benchmark::State& state) {
     std::string s;
     for (auto _ : state) {
@@ -156,6 +168,531 @@ static void QAlloc_List_Double_Emplace_Reset(benchmark::State& state) {
     }
 }
 
+static void QAlloc_Basic_Vector_Int_Emplace_Reset(benchmark::State& state) {
+    std::vector<int, qalloc::basic_allocator<int>> v;
+    for (auto _ : state) {
+        v_emplace_reset(v, 0);
+    }
+}
+
+static void QAlloc_Simple_Map_Int_Int_Insert_Reset(benchmark::State& state) {
+    qalloc::simple::map<int, int> m;
+    for (auto _ : state) {
+        m_insert_reset(m);
+    }
+}
+
+static void QAlloc_Basic_Map_Int_Int_Insert_Reset(benchmark::State& state) {
+    std::map<int, int, std::less<int>, qalloc::basic_allocator<std::pair<const int, int>>> m;
+    for (auto _ : state) {
+        m_insert_reset(m);
+    }
+}
+
+static void QAlloc_Basic_List_Double_Emplace_Reset(benchmark::State& state) {
+    std::list<double, qalloc::basic_allocator<double>> l;
+    for (auto _ : state) {
+        list_emplace_reset(l);
+    }
+}
+
+template <typename TestMap>
+static void m_churn(TestMap& m) {
+    for (int i = 0; i < 256; ++i) {
+        m[i] = i;
+    }
+    for (int i = 0; i < 256; i += 2) {
+        m.erase(i);
+    }
+    for (int i = 0; i < 256; i += 2) {
+        m[i + 256] = i;
+    }
+    m.clear();
+}
+
+template <typename TestList>
+static void list_churn(TestList& l) {
+    for (int i = 0; i < 256; ++i) {
+        l.emplace_back(i);
+    }
+    for (auto it = l.begin(); it != l.end(); ) {
+        it = l.erase(it);
+        ++it;
+    }
+    for (int i = 0; i < 128; ++i) {
+        l.emplace_front(i);
+    }
+    l.clear();
+}
+
+static void Std_Map_Int_Int_Churn(benchmark::State& state) {
+    std::map<int, int> m;
+    for (auto _ : state) {
+        m_churn(m);
+    }
+}
+
+static void QAlloc_Map_Int_Int_Churn(benchmark::State& state) {
+    qalloc::map<int, int> m;
+    for (auto _ : state) {
+        m_churn(m);
+    }
+}
+
+static void Std_List_Double_Churn(benchmark::State& state) {
+    std::list<double> l;
+    for (auto _ : state) {
+        list_churn(l);
+    }
+}
+
+static void QAlloc_List_Double_Churn(benchmark::State& state) {
+    qalloc::list<double> l;
+    for (auto _ : state) {
+        list_churn(l);
+    }
+}
+
+template <typename TestVector>
+static void v_move_assign(benchmark::State& state) {
+    TestVector a(4096, 1);
+    TestVector b;
+    for (auto _ : state) {
+        b = std::move(a);
+        a = std::move(b);
+    }
+}
+
+template <typename TestVector>
+static void v_swap(benchmark::State& state) {
+    TestVector a(4096, 1);
+    TestVector b(16, 2);
+    for (auto _ : state) {
+        std::swap(a, b);
+    }
+    benchmark::DoNotOptimize(a.data());
+}
+
+static void Std_Vector_Int_Move_Assign(benchmark::State& state) {
+    v_move_assign<std::vector<int>>(state);
+}
+
+static void QAlloc_Vector_Int_Move_Assign(benchmark::State& state) {
+    v_move_assign<qalloc::vector<int>>(state);
+}
+
+static void Std_Vector_Int_Swap(benchmark::State& state) {
+    v_swap<std::vector<int>>(state);
+}
+
+static void QAlloc_Vector_Int_Swap(benchmark::State& state) {
+    v_swap<qalloc::vector<int>>(state);
+}
+
+static void QAlloc_Pool_Alloc_Free_Each(benchmark::State& state) {
+    qalloc::pool_t pool(4096);
+    std::vector<qalloc::byte_pointer> blocks(1024);
+    for (auto _ : state) {
+        for (auto& block : blocks) {
+            block = pool.allocate(32);
+        }
+        for (auto* block : blocks) {
+            pool.deallocate(block, 32);
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(blocks.size()));
+}
+
+static void QAlloc_Pool_Alloc_Free_Batch(benchmark::State& state) {
+    qalloc::pool_t pool(4096);
+    std::vector<qalloc::byte_pointer> blocks(1024);
+    for (auto _ : state) {
+        pool.allocate_batch(32, blocks.size(), blocks.data());
+        pool.deallocate_batch(blocks.data(), blocks.size(), 32);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(blocks.size()));
+}
+
+template <qalloc::pool_mode mode>
+static void map_teardown(benchmark::State& state) {
+    using pair_allocator = qalloc::simple_allocator<std::pair<const int, int>>;
+    using test_map = qalloc::simple::map<int, int>;
+    qalloc::pool_t pool(1 << 16);
+    pool.set_mode(mode);
+    for (auto _ : state) {
+        state.PauseTiming();
+        test_map m{pair_allocator(&pool)};
+        for (int i = 0; i < 4096; ++i) {
+            m[(i * 7919) % 4096] = i; // scattered insertion order, so frees are not address ordered
+        }
+        state.ResumeTiming();
+        m = test_map(pair_allocator(&pool));
+    }
+}
+
+static void QAlloc_Map_Teardown_Immediate(benchmark::State& state) {
+    map_teardown<qalloc::pool_mode::immediate>(state);
+}
+
+static void QAlloc_Map_Teardown_Deferred(benchmark::State& state) {
+    map_teardown<qalloc::pool_mode::deferred>(state);
+}
+
+template <qalloc::pool_mode mode>
+static void request_scratch(benchmark::State& state) {
+    using pair_allocator = qalloc::simple_allocator<std::pair<const int, int>>;
+    using test_map = qalloc::simple::map<int, int>;
+    qalloc::pool_t pool(1 << 16);
+    pool.set_mode(mode);
+    for (auto _ : state) {
+        {
+            test_map m{pair_allocator(&pool)};
+            qalloc::simple::vector<int> v{qalloc::simple_allocator<int>(&pool)};
+            for (int i = 0; i < 1024; ++i) {
+                m[(i * 7919) % 1024] = i;
+                v.push_back(i);
+            }
+            benchmark::ClobberMemory();
+        }
+        if (mode == qalloc::pool_mode::monotonic) {
+            pool.release();
+        }
+    }
+}
+
+static void QAlloc_Request_Scratch_Immediate(benchmark::State& state) {
+    request_scratch<qalloc::pool_mode::immediate>(state);
+}
+
+static void QAlloc_Request_Scratch_Monotonic(benchmark::State& state) {
+    request_scratch<qalloc::pool_mode::monotonic>(state);
+}
+
+static void QAlloc_Phase_Deallocate_Each(benchmark::State& state) {
+    qalloc::pool_t pool(1 << 16);
+    std::vector<qalloc::byte_pointer> blocks(4096);
+    for (auto _ : state) {
+        for (size_t i = 0; i < blocks.size(); ++i) {
+            blocks[i] = pool.allocate(48);
+        }
+        for (size_t i = 0; i < blocks.size(); ++i) {
+            pool.deallocate(blocks[(i * 7919) % blocks.size()], 48);
+        }
+        benchmark::ClobberMemory();
+    }
+}
+
+static void QAlloc_Phase_Rewind(benchmark::State& state) {
+    qalloc::pool_t pool(1 << 16);
+    std::vector<qalloc::byte_pointer> blocks(4096);
+    for (auto _ : state) {
+        qalloc::scope phase(pool);
+        for (size_t i = 0; i < blocks.size(); ++i) {
+            blocks[i] = pool.allocate(48);
+        }
+        benchmark::ClobberMemory();
+    }
+}
+
+static void child_pool_requests(benchmark::State& state, const qalloc::pool_t* parent) {
+    for (auto _ : state) {
+        qalloc::pool_t child(1 << 12, parent);
+        for (int i = 0; i < 64; ++i) {
+            benchmark::DoNotOptimize(child.allocate(512)); // grows into a few more subpools
+        }
+    }
+}
+
+static void QAlloc_Child_Pool_From_System(benchmark::State& state) {
+    child_pool_requests(state, nullptr);
+}
+
+static void QAlloc_Child_Pool_From_Upstream(benchmark::State& state) {
+    qalloc::pool_t parent(1 << 20);
+    child_pool_requests(state, &parent);
+}
+
+static void QAlloc_Large_Map_Destroy(benchmark::State& state) {
+    using test_map = qalloc::simple::map<int, int>;
+    qalloc::pool_t pool(1 << 20);
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto* m = new test_map(qalloc::simple_allocator<std::pair<const int, int>>(&pool));
+        for (int i = 0; i < (1 << 18); ++i) {
+            (*m)[i] = i;
+        }
+        state.ResumeTiming();
+        delete m;
+    }
+}
+
+static void QAlloc_Large_Map_Wink_Out(benchmark::State& state) {
+    qalloc::wink::map<int, int> m(1 << 20);
+    for (auto _ : state) {
+        state.PauseTiming();
+        for (int i = 0; i < (1 << 18); ++i) {
+            (*m)[i] = i;
+        }
+        state.ResumeTiming();
+        m.wink_out();
+    }
+}
+
+static void QAlloc_Small_Vector_Thread_Pool(benchmark::State& state) {
+    for (auto _ : state) {
+        qalloc::simple::vector<int> v;
+        for (int i = 0; i < 16; ++i) {
+            v.push_back(i);
+        }
+        benchmark::ClobberMemory();
+    }
+}
+
+static void QAlloc_Small_Vector_Inline_Pool(benchmark::State& state) {
+    for (auto _ : state) {
+        qalloc::inline_pool<256> pool;
+        std::vector<int, qalloc::inline_allocator<int, 256>> v(pool);
+        for (int i = 0; i < 16; ++i) {
+            v.push_back(i);
+        }
+        benchmark::ClobberMemory();
+    }
+}
+
+template <qalloc::lifetime_class lifetime>
+static void gc_after_churn(benchmark::State& state) {
+    std::vector<qalloc::byte_pointer> long_lived, short_lived;
+    size_t n_bytes_reclaimed = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        qalloc::pool_t pool(1 << 12);
+        for (int i = 0; i < (1 << 14); ++i) {
+            if (i % 64 == 0) { // a few survivors among request temporaries
+                long_lived.push_back(pool.allocate(64));
+            }
+            else {
+                short_lived.push_back(pool.allocate(64, lifetime));
+            }
+        }
+        for (auto p : short_lived) {
+            pool.deallocate(p, 64);
+        }
+        state.ResumeTiming();
+        n_bytes_reclaimed += pool.gc();
+        state.PauseTiming();
+        long_lived.clear();
+        short_lived.clear();
+        state.ResumeTiming();
+    }
+    state.counters["bytes_reclaimed"] = benchmark::Counter(static_cast<double>(n_bytes_reclaimed),
+                                                           benchmark::Counter::kAvgIterations);
+}
+
+static void QAlloc_GC_Mixed_Lifetimes(benchmark::State& state) {
+    gc_after_churn<qalloc::lifetime_class::normal>(state);
+}
+
+static void QAlloc_GC_Segregated_Lifetimes(benchmark::State& state) {
+    gc_after_churn<qalloc::lifetime_class::short_lived>(state);
+}
+
+struct order_t {
+    long   id;
+    double price;
+    int    quantity;
+    char   side;
+};
+
+static constexpr size_t n_orders = 4096;
+
+static void QAlloc_Object_Pool_Create_Destroy(benchmark::State& state) {
+    qalloc::object_pool<order_t> pool;
+    std::vector<order_t*> orders(n_orders);
+    for (auto _ : state) {
+        for (size_t i = 0; i < n_orders; ++i) {
+            orders[i] = pool.create(order_t{static_cast<long>(i), 1.0, 1, 'b'});
+        }
+        for (size_t i = 0; i < n_orders; ++i) {
+            pool.destroy(orders[(i * 7919) % n_orders]);
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(n_orders));
+}
+
+static void QAlloc_Allocator_Create_Destroy(benchmark::State& state) {
+    qalloc::pool_t pool(1 << 16);
+    qalloc::allocator<order_t> allocator(&pool);
+    std::vector<order_t*> orders(n_orders);
+    for (auto _ : state) {
+        for (size_t i = 0; i < n_orders; ++i) {
+            orders[i] = new (allocator.allocate(1)) order_t{static_cast<long>(i), 1.0, 1, 'b'};
+        }
+        for (size_t i = 0; i < n_orders; ++i) {
+            allocator.deallocate(orders[(i * 7919) % n_orders], 1);
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(n_orders));
+}
+
+static void New_Delete_Create_Destroy(benchmark::State& state) {
+    std::vector<order_t*> orders(n_orders);
+    for (auto _ : state) {
+        for (size_t i = 0; i < n_orders; ++i) {
+            orders[i] = new order_t{static_cast<long>(i), 1.0, 1, 'b'};
+        }
+        for (size_t i = 0; i < n_orders; ++i) {
+            delete orders[(i * 7919) % n_orders];
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(n_orders));
+}
+
+struct message_t {
+    qalloc::string      body;
+    qalloc::vector<int> fields;
+
+    void reset() {
+        body.clear();
+        fields.clear();
+    }
+};
+
+static void fill_message(message_t& message) {
+    message.body.append(512, 'x');
+    for (int i = 0; i < 64; ++i) {
+        message.fields.push_back(i);
+    }
+}
+
+static void QAlloc_Message_Construct_Per_Request(benchmark::State& state) {
+    qalloc::simple_allocator<message_t> allocator;
+    for (auto _ : state) {
+        message_t* message = new (allocator.allocate(1)) message_t();
+        fill_message(*message);
+        benchmark::ClobberMemory();
+        message->~message_t();
+        allocator.deallocate(message, 1);
+    }
+}
+
+static void QAlloc_Message_Recycled(benchmark::State& state) {
+    auto& pool = qalloc::get_recycling_pool<message_t>();
+    for (auto _ : state) {
+        auto message = pool.acquire_unique();
+        fill_message(*message);
+        benchmark::ClobberMemory();
+    }
+}
+
+struct tree_node_t {
+    tree_node_t* left;
+    tree_node_t* right;
+    long key;
+    char payload[40];
+};
+
+static long tree_sum(const tree_node_t* node) {
+    return node == nullptr ? 0 : node->key + tree_sum(node->left) + tree_sum(node->right);
+}
+
+template <bool hinted>
+static void tree_traversal(benchmark::State& state) {
+    qalloc::pool_t pool(1 << 20);
+    std::mt19937 rng(42);
+    // fragment the pool first, a scattered half of a large batch is freed again
+    std::vector<qalloc::byte_pointer> filler(1 << 17);
+    pool.allocate_batch(sizeof(tree_node_t), filler.size(), filler.data());
+    std::shuffle(filler.begin(), filler.end(), rng);
+    pool.deallocate_batch(filler.data(), filler.size() / 2, sizeof(tree_node_t));
+    tree_node_t* root = nullptr;
+    for (int i = 0; i < (1 << 16); ++i) {
+        long key = static_cast<long>(rng());
+        tree_node_t* parent = nullptr;
+        tree_node_t** link = &root;
+        while (*link != nullptr) {
+            parent = *link;
+            link = key < parent->key ? &parent->left : &parent->right;
+        }
+        qalloc::byte_pointer p = hinted ? pool.allocate_near(parent, sizeof(tree_node_t)) : pool.allocate(sizeof(tree_node_t));
+        *link = new (p) tree_node_t{nullptr, nullptr, key, {}};
+    }
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(tree_sum(root));
+    }
+}
+
+static void QAlloc_Tree_Traversal(benchmark::State& state) {
+    tree_traversal<false>(state);
+}
+
+static void QAlloc_Tree_Traversal_Allocated_Near(benchmark::State& state) {
+    tree_traversal<true>(state);
+}
+
+struct percpu_bench_object_t {
+    char data[48];
+};
+
+template <typename Allocator>
+static void alloc_free_churn(Allocator& allocator) {
+    typename Allocator::pointer objects[16];
+    for (auto& object : objects) {
+        object = allocator.allocate(1);
+    }
+    benchmark::ClobberMemory();
+    for (auto& object : objects) {
+        allocator.deallocate(object, 1);
+    }
+}
+
+static void QAlloc_Thread_Local_Pool_Alloc_Free(benchmark::State& state) {
+    qalloc::simple_allocator<percpu_bench_object_t> allocator;
+    for (auto _ : state) {
+        alloc_free_churn(allocator);
+    }
+    // summed over all threads
+    state.counters["pool_bytes"] = static_cast<double>(allocator.pool()->pool_size());
+}
+
+static void QAlloc_Per_Cpu_Pool_Alloc_Free(benchmark::State& state) {
+    qalloc::percpu_allocator<percpu_bench_object_t> allocator;
+    for (auto _ : state) {
+        alloc_free_churn(allocator);
+    }
+    if (state.thread_index() == 0) {
+        state.counters["pool_bytes"] = static_cast<double>(qalloc::internal::get_percpu_pool().pool_size());
+    }
+}
+
+template <bool offload>
+static void large_vector_free(benchmark::State& state) {
+    if (offload) {
+        qalloc::deallocation_service().start();
+    }
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto* v = new qalloc::vector<char>(8 << 20, 'x');
+        state.ResumeTiming();
+        delete v; // only the free is timed
+    }
+    if (offload) {
+        qalloc::deallocation_service().stop();
+    }
+}
+
+static void QAlloc_Large_Vector_Free(benchmark::State& state) {
+    large_vector_free<false>(state);
+}
+
+static void QAlloc_Large_Vector_Free_Offloaded(benchmark::State& state) {
+    large_vector_free<true>(state);
+}
+
 BENCHMARK(Std_Vector_String_Emplace_Reset);
 BENCHMARK(Std_Vector_QAlloc_String_Emplace_Reset);
 BENCHMARK(QAlloc_Vector_Std_String_Emplace_Reset);
@@ -164,11 +701,51 @@ BENCHMARK(Std_Vector_Int_Emplace_Reset);
 BENCHMARK(QAlloc_Vector_Int_Emplace_Reset);
 BENCHMARK(Std_String_Creation);
 BENCHMARK(QAlloc_String_Creation);
+BENCHMARK(QAlloc_Stateless_String_Creation);
 BENCHMARK(Std_String_Append_Reset);
 BENCHMARK(QAlloc_String_Append_Reset);
 BENCHMARK(Std_Unordered_Map_Int_Int_Insert_Reset);
 BENCHMARK(QAlloc_Unordered_Map_Int_Int_Insert_Reset);
 BENCHMARK(Std_List_Double_Emplace_Reset);
 BENCHMARK(QAlloc_List_Double_Emplace_Reset);
+BENCHMARK(Std_Map_Int_Int_Churn);
+BENCHMARK(QAlloc_Map_Int_Int_Churn);
+BENCHMARK(Std_List_Double_Churn);
+BENCHMARK(QAlloc_List_Double_Churn);
+BENCHMARK(Std_Vector_Int_Move_Assign);
+BENCHMARK(QAlloc_Vector_Int_Move_Assign);
+BENCHMARK(Std_Vector_Int_Swap);
+BENCHMARK(QAlloc_Vector_Int_Swap);
+BENCHMARK(QAlloc_Pool_Alloc_Free_Each);
+BENCHMARK(QAlloc_Pool_Alloc_Free_Batch);
+BENCHMARK(QAlloc_Map_Teardown_Immediate);
+BENCHMARK(QAlloc_Map_Teardown_Deferred);
+BENCHMARK(QAlloc_Request_Scratch_Immediate);
+BENCHMARK(QAlloc_Request_Scratch_Monotonic);
+BENCHMARK(QAlloc_Phase_Deallocate_Each);
+BENCHMARK(QAlloc_Phase_Rewind);
+BENCHMARK(QAlloc_Child_Pool_From_System);
+BENCHMARK(QAlloc_Child_Pool_From_Upstream);
+BENCHMARK(QAlloc_Large_Map_Destroy)->Iterations(16);
+BENCHMARK(QAlloc_Large_Map_Wink_Out)->Iterations(16);
+BENCHMARK(QAlloc_Small_Vector_Thread_Pool);
+BENCHMARK(QAlloc_Small_Vector_Inline_Pool);
+BENCHMARK(QAlloc_GC_Mixed_Lifetimes)->Iterations(64);
+BENCHMARK(QAlloc_GC_Segregated_Lifetimes)->Iterations(64);
+BENCHMARK(QAlloc_Object_Pool_Create_Destroy);
+BENCHMARK(QAlloc_Allocator_Create_Destroy);
+BENCHMARK(New_Delete_Create_Destroy);
+BENCHMARK(QAlloc_Message_Construct_Per_Request);
+BENCHMARK(QAlloc_Message_Recycled);
+BENCHMARK(QAlloc_Tree_Traversal);
+BENCHMARK(QAlloc_Tree_Traversal_Allocated_Near);
+BENCHMARK(QAlloc_Basic_Vector_Int_Emplace_Reset);
+BENCHMARK(QAlloc_Simple_Map_Int_Int_Insert_Reset);
+BENCHMARK(QAlloc_Basic_Map_Int_Int_Insert_Reset);
+BENCHMARK(QAlloc_Basic_List_Double_Emplace_Reset);
+BENCHMARK(QAlloc_Large_Vector_Free)->Iterations(256);
+BENCHMARK(QAlloc_Large_Vector_Free_Offloaded)->Iterations(256);
+BENCHMARK(QAlloc_Thread_Local_Pool_Alloc_Free)->Threads(256)->UseRealTime();
+BENCHMARK(QAlloc_Per_Cpu_Pool_Alloc_Free)->Threads(256)->UseRealTime();
 
-BENCHMARK_MAIN();
\ No newline at end of file
+BENCHMARK_MAIN();
\ No newline at end of file
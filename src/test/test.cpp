@@ -18,7 +18,10 @@
 /// @date 2022-07-02
 
 #include <qalloc/qalloc.hpp>
+#include <array>
 #include <thread>
+#include <mutex>
+#include <deque>
 #include <gtest/gtest.h>
 
 constexpr char DIGITS[] = "0123456789";
@@ -93,6 +96,28 @@ static int emplace_index(std::size_t i) {
 }
 
 
+struct message_t {
+    qalloc::string body;
+    qalloc::vector<int> fields;
+
+    void reset() {
+        body.clear();
+        fields.clear();
+    }
+};
+
+struct hot_object_t {
+    int values[4];
+};
+
+template <>
+struct qalloc::pool_traits<hot_object_t> : qalloc::pool_traits<void> {
+    static constexpr qalloc::size_type initial_size = 1024;
+    static constexpr bool detailed = true;
+    using growth_policy = qalloc::fixed_growth_t;
+    using page_provider = qalloc::prefaulted_page_provider_t;
+};
+
 static qalloc::string emplace_index_qalloc_string(std::size_t i) {
     auto std_str = std::to_string(i);
     return {
@@ -116,6 +141,557 @@ TEST(QAllocSingleThread, QAllocListInt) {
     test_list<qalloc::list<int>>(emplace_index);
 }
 
+TEST(QAllocSingleThread, EpochRetireReclaim) {
+    qalloc::shared_pool_t pool;
+    qalloc::byte_pointer p = pool.allocate(64);
+    {
+        qalloc::epoch::guard guard;
+        qalloc::epoch::retire(&pool, p, 64);
+        qalloc::epoch::reclaim();
+        ASSERT_EQ(qalloc::epoch::reclaim(), 0); // still inside the region the block was retired in
+    }
+    std::size_t n_reclaimed = 0;
+    for (int i = 0; i < 4 && n_reclaimed == 0; i++) {
+        n_reclaimed = qalloc::epoch::reclaim();
+    }
+    ASSERT_GE(n_reclaimed, 64);
+    ASSERT_EQ(pool.allocate(64), p); // back on the free list of the pool
+}
+
+TEST(QAllocSingleThread, IsolatedAllocator) {
+    qalloc::pool_t pool(100);
+    qalloc::isolated_allocator<int> allocator(&pool);
+    int* a = allocator.allocate(1);
+    int* b = allocator.allocate(20);
+    int* c = allocator.allocate(1);
+    for (int* p : {a, b, c}) {
+        ASSERT_EQ(reinterpret_cast<std::uintptr_t>(p) % QALLOC_CACHE_LINE_SIZE, 0);
+    }
+    ASSERT_GE(reinterpret_cast<qalloc::byte_pointer>(b) - reinterpret_cast<qalloc::byte_pointer>(a), QALLOC_CACHE_LINE_SIZE);
+    ASSERT_EQ(pool.padding_bytes(), (QALLOC_CACHE_LINE_SIZE - sizeof(int)) * 2 + (128 - 20 * sizeof(int)));
+    allocator.deallocate(b, 20);
+    ASSERT_EQ(pool.padding_bytes(), (QALLOC_CACHE_LINE_SIZE - sizeof(int)) * 2);
+    test_v<std::vector<int, qalloc::isolated_allocator<int>>>(emplace_index);
+    allocator.deallocate(a, 1);
+    allocator.deallocate(c, 1);
+    ASSERT_EQ(pool.padding_bytes(), 0);
+    constexpr std::size_t n_large = QALLOC_LARGE_BLOCK_SIZE / sizeof(int) + 1;
+    int* large = allocator.allocate(n_large); // bypasses the subpools
+    ASSERT_EQ(reinterpret_cast<std::uintptr_t>(large) % QALLOC_CACHE_LINE_SIZE, 0);
+    ASSERT_EQ(pool.large_bytes(), QALLOC_LARGE_BLOCK_SIZE + QALLOC_CACHE_LINE_SIZE); // rounded up to whole lines
+    allocator.deallocate(large, n_large);
+    ASSERT_EQ(pool.large_bytes(), 0);
+    ASSERT_EQ(pool.padding_bytes(), 0);
+}
+
+TEST(QAllocSingleThread, PoolMove) {
+    qalloc::pool_t pool(128);
+    qalloc::byte_pointer p = pool.allocate(40);
+    qalloc::pool_t moved(std::move(pool));
+    ASSERT_EQ(pool.pool_size(), 0);
+    ASSERT_EQ(moved.pool_size(), 128);
+    moved.deallocate(p, 40);
+    ASSERT_EQ(moved.allocate(40), p);
+    qalloc::pool_t assigned(64);
+    assigned = std::move(moved);
+    ASSERT_EQ(assigned.pool_size(), 128);
+    ASSERT_EQ(assigned.bytes_used(), 40);
+}
+
+TEST(QAllocSingleThread, BasicPool) {
+    test_v<std::vector<int, qalloc::basic_allocator<int>>>(emplace_index);
+    test_list<std::list<int, qalloc::basic_allocator<int>>>(emplace_index);
+    qalloc::basic_pool<qalloc::sorted_free_list_t, qalloc::fixed_growth_t> pool(64);
+    qalloc::byte_pointer a = pool.allocate(24);
+    qalloc::byte_pointer b = pool.allocate(24);
+    pool.deallocate(a, 24);
+    pool.deallocate(b, 24); // merged with a
+    ASSERT_EQ(pool.bytes_used(), 0);
+    ASSERT_NE(pool.allocate(48), nullptr);
+    qalloc::byte_pointer c = pool.allocate(32); // does not fit, a subpool of the same size is added
+    ASSERT_EQ(pool.allocate(32), c + 32);
+    ASSERT_EQ(pool.pool_size(), 128);
+}
+
+TEST(QAllocSingleThread, AllocatorEquality) {
+    qalloc::pool_t pool(256);
+    ASSERT_EQ(qalloc::allocator<int>(), qalloc::allocator<int>());
+    ASSERT_EQ(qalloc::allocator<int>(&pool), qalloc::allocator<long>(&pool));
+    ASSERT_NE(qalloc::allocator<int>(&pool), qalloc::simple_allocator<int>(&pool));
+    ASSERT_NE(qalloc::allocator<int>(&pool), qalloc::allocator<int>());
+    qalloc::vector<int> a(100, 1);
+    qalloc::vector<int> b{qalloc::allocator<int>(&pool)};
+    b.assign(10, 2);
+    const int* a_data = a.data();
+    const int* b_data = b.data();
+    std::swap(a, b); // buffers and pools are exchanged, nothing is copied
+    ASSERT_EQ(a.data(), b_data);
+    ASSERT_EQ(b.data(), a_data);
+    ASSERT_EQ(a.get_allocator().pool(), &pool);
+    b = std::move(a);
+    ASSERT_EQ(b.data(), b_data);
+    ASSERT_EQ(b.get_allocator().pool(), &pool);
+}
+
+TEST(QAllocSingleThread, StatelessAllocator) {
+    static_assert(std::is_empty<qalloc::stateless_allocator<int>>::value, "stateless allocator must not hold state");
+    static_assert(sizeof(qalloc::stateless::string) == sizeof(std::string), "stateless string must be as large as std::string");
+    test_v<qalloc::stateless::vector<int>>(emplace_index);
+    test_list<qalloc::stateless::list<int>>(emplace_index);
+    qalloc::stateless::string s("a string too long for the small string buffer");
+    qalloc::stateless::string copy(s);
+    ASSERT_EQ(s, copy);
+}
+
+TEST(QAllocSingleThread, RebindRouting) {
+    qalloc::allocator<int> default_allocator;
+    qalloc::allocator<double> rebound(default_allocator);
+    ASSERT_EQ(rebound.pool(), qalloc::internal::get_pool<double>()); // default pools follow the rebind
+    ASSERT_EQ(rebound, default_allocator);
+    // the pool of int is what a rebind to double gives only when the default pools are shared, as in debug builds
+    const bool shared_pools = qalloc::internal::get_pool<int>() == qalloc::internal::get_pool<double>();
+    ASSERT_EQ(qalloc::allocator<double>(qalloc::internal::get_pool<int>()) == default_allocator, shared_pools);
+    ASSERT_EQ(qalloc::isolated_allocator<int>(), qalloc::isolated_allocator<double>());
+    qalloc::pool_t pool(1024);
+    using pair_allocator = qalloc::allocator<std::pair<const int, int>>;
+    qalloc::map<int, int> m{pair_allocator(&pool)};
+    for (int i = 0; i < 16; i++) {
+        m[i] = i;
+    }
+    ASSERT_GE(pool.bytes_used(), 16 * sizeof(std::pair<const int, int>)); // custom pools are kept
+    ASSERT_EQ(m.get_allocator().pool(), &pool);
+}
+
+TEST(QAllocSingleThread, PoolSizeClasses) {
+    using qalloc::internal::pool_size_class_of;
+    static_assert(pool_size_class_of<char>() == pool_size_class_of<double>(), "small types share the first class");
+    static_assert(pool_size_class_of<std::pair<double, double>>() == 1, "16 bytes go to the second class");
+    static_assert(pool_size_class_of(513) == qalloc::internal::n_pool_size_classes - 1, "the last class takes the rest");
+    struct alignas(64) over_aligned_t { char c; };
+    ASSERT_EQ(pool_size_class_of<over_aligned_t>(), pool_size_class_of(64));
+}
+
+TEST(QAllocSingleThread, PoolTraits) {
+    qalloc::traits_allocator<hot_object_t> allocator;
+    ASSERT_EQ(allocator.pool()->pool_size(), 1024);
+    hot_object_t* p = allocator.allocate(1);
+    ASSERT_EQ(qalloc::type_of(p), typeid(hot_object_t));
+    std::vector<hot_object_t, qalloc::traits_allocator<hot_object_t>> v(100);
+    // fixed growth, a request larger than the initial size gets a subpool of its own size, rounded to 16 bytes
+    ASSERT_EQ(allocator.pool()->pool_size(), 1024 + (100 * sizeof(hot_object_t) + qalloc::block_info_t::header_size_of<hot_object_t>() + 15) / 16 * 16);
+    allocator.deallocate(p, 1);
+    test_list<std::list<int, qalloc::traits_allocator<int>>>(emplace_index);
+    qalloc::traits_pool_t<int> custom(4096);
+    std::list<int, qalloc::traits_allocator<int>> l{qalloc::traits_allocator<int>(custom)};
+    l.push_back(1); // the node allocator is rebound from it and keeps the pool
+    ASSERT_GT(custom.bytes_used(), 0);
+}
+
+TEST(QAllocSingleThread, ExpandAndShrink) {
+    qalloc::pool_t pool(256);
+    qalloc::byte_pointer a = pool.allocate(32);
+    ASSERT_TRUE(pool.try_expand(a, 32, 64)); // the bump pointer sits right after a
+    qalloc::byte_pointer b = pool.allocate(64);
+    ASSERT_EQ(b, a + 64);
+    ASSERT_FALSE(pool.try_expand(a, 64, 96));
+    ASSERT_TRUE(pool.shrink(b, 64, 16));
+    ASSERT_TRUE(pool.shrink(a, 64, 32)); // the tail becomes a freed block
+    ASSERT_TRUE(pool.try_expand(a, 32, 48)); // and can be taken back
+    ASSERT_EQ(pool.bytes_used(), 48 + 16);
+
+    qalloc::simple_allocator<int> allocator(&pool);
+    int* c = allocator.allocate(10);
+    allocator.deallocate(c, 10);
+    auto result = allocator.allocate_at_least(8); // a 40 byte block is not worth splitting
+    ASSERT_EQ(result.ptr, c);
+    ASSERT_EQ(result.count, 10);
+    allocator.deallocate(result.ptr, result.count);
+    qalloc::allocator<int> detailed_allocator(&pool);
+    auto detailed_result = detailed_allocator.allocate_at_least(6);
+    ASSERT_GE(detailed_result.count, 6);
+    ASSERT_TRUE(detailed_allocator.try_expand(detailed_result.ptr, detailed_result.count, detailed_result.count + 4));
+    detailed_allocator.deallocate(detailed_result.ptr, detailed_result.count + 4);
+}
+
+TEST(QAllocSingleThread, BatchAllocation) {
+    qalloc::pool_t pool(256);
+    qalloc::byte_pointer blocks[40];
+    pool.allocate_batch(16, 8, blocks);
+    for (int i = 1; i < 8; i++) {
+        ASSERT_EQ(blocks[i], blocks[i - 1] + 16); // one contiguous run
+    }
+    std::swap(blocks[0], blocks[5]);
+    pool.deallocate_batch(blocks, 8, 16);
+    ASSERT_EQ(pool.bytes_used(), 0);
+    pool.allocate_batch(32, 40, blocks); // 4 from the merged block, the rest from a new subpool
+    ASSERT_EQ(pool.bytes_used(), 40 * 32);
+    pool.deallocate_batch(blocks, 40, 32);
+
+    qalloc::allocator<int> allocator(&pool);
+    std::vector<int*> arrays(300);
+    allocator.allocate_batch(4, arrays.size(), arrays.data());
+    for (int* array : arrays) {
+        ASSERT_EQ(qalloc::block_info_t::of(array)->type_id, qalloc::type_id_of<int>());
+    }
+    allocator.deallocate_batch(arrays.data(), arrays.size(), 4);
+    ASSERT_EQ(pool.bytes_used(), 0);
+}
+
+TEST(QAllocSingleThread, DeferredFreeMerging) {
+    qalloc::pool_t pool(4096);
+    pool.set_mode(qalloc::pool_mode::deferred);
+    qalloc::byte_pointer blocks[64];
+    pool.allocate_batch(16, 64, blocks);
+    for (int i = 0; i < 64; i += 2) {
+        pool.deallocate(blocks[i], 16);
+    }
+    for (int i = 63; i > 0; i -= 2) {
+        pool.deallocate(blocks[i], 16);
+    }
+    ASSERT_EQ(pool.bytes_used(), 0); // buffered frees count as free
+    ASSERT_EQ(pool.allocate_at_least(1024).count, 1024); // flushed and coalesced into one block
+    pool.set_mode(qalloc::pool_mode::immediate);
+    qalloc::byte_pointer a = pool.allocate(32);
+    qalloc::byte_pointer b = pool.allocate(32);
+    qalloc::byte_pointer c = pool.allocate(32);
+    pool.deallocate(a, 32);
+    pool.deallocate(c, 32);
+    pool.deallocate(b, 32); // merges with both neighbors
+    ASSERT_EQ(pool.allocate(96), a);
+    qalloc::pool_t merged(8192);
+    merged.set_mode(qalloc::pool_mode::deferred);
+    qalloc::byte_pointer cells[256];
+    merged.allocate_batch(32, 256, cells);
+    for (int i = 0; i < 256; i += 2) {
+        merged.deallocate(cells[i], 32);
+    }
+    merged.flush_deferred(); // 128 blocks apart from each other
+    for (int i = 255; i > 0; i -= 2) {
+        merged.deallocate(cells[i], 32);
+    }
+    merged.flush_deferred(); // each one closes a gap between two listed blocks
+    ASSERT_EQ(merged.bytes_used(), 0);
+    ASSERT_EQ(merged.allocate_at_least(256 * 32).ptr, cells[0]);
+}
+
+TEST(QAllocSingleThread, AllocateNear) {
+    qalloc::pool_t pool(4096);
+    qalloc::byte_pointer blocks[64];
+    pool.allocate_batch(32, 64, blocks);
+    pool.deallocate(blocks[2], 32);
+    pool.deallocate(blocks[40], 32);
+    pool.deallocate(blocks[60], 32);
+    ASSERT_EQ(pool.allocate_near(blocks[38], 32), blocks[40]);
+    ASSERT_EQ(pool.allocate_near(blocks[1], 32), blocks[2]);
+    ASSERT_EQ(pool.allocate_near(blocks[63], 32), blocks[63] + 32); // the bump pointer is closer than blocks[60]
+    qalloc::allocator<int> allocator(&pool);
+    int* a = allocator.allocate(8);
+    allocator.deallocate(a, 8);
+    ASSERT_EQ(std::allocator_traits<qalloc::allocator<int>>::allocate(allocator, 8, a), a);
+}
+
+TEST(QAllocSingleThread, TypeRegistry) {
+    static_assert(sizeof(qalloc::block_info_t) == 4, "compact header");
+    ASSERT_NE(qalloc::type_id_of<double>(), 0);
+    ASSERT_EQ(qalloc::type_id_of<double>(), qalloc::type_id_of<const double>());
+    ASSERT_NE(qalloc::type_id_of<double>(), qalloc::type_id_of<float>());
+    using pair_t = std::pair<int, double>;
+    qalloc::pool_t pool(256);
+    qalloc::allocator<pair_t> allocator(&pool);
+    auto* p = allocator.allocate(1);
+    ASSERT_EQ(qalloc::type_of(p), typeid(pair_t));
+    ASSERT_EQ(qalloc::demangled_type_name_of(p), qalloc::demangled_type_name_of(typeid(pair_t).name()));
+    ASSERT_EQ(&qalloc::demangled_type_name_of(p), &qalloc::demangled_type_name_of(p)); // interned once
+    ASSERT_EQ(&qalloc::safe_cast<pair_t>(p), p);
+    ASSERT_THROW(qalloc::safe_cast<double>(p), std::bad_cast);
+    allocator.deallocate(p, 1);
+}
+
+struct alignas(64) cache_line_t {
+    int value;
+};
+
+TEST(QAllocSingleThread, HeaderAlignment) {
+    qalloc::pool_t pool(4096);
+    std::vector<double, qalloc::allocator<double>> doubles(qalloc::allocator<double>{&pool});
+    doubles.resize(3);
+    ASSERT_TRUE(qalloc::pointer::is_aligned(doubles.data(), alignof(double)));
+    ASSERT_EQ(qalloc::type_of(doubles.data()), typeid(double));
+    pool.allocate(3); // the over-aligned ones do not rely on the bump pointer
+    std::vector<cache_line_t, qalloc::allocator<cache_line_t>> lines(qalloc::allocator<cache_line_t>{&pool});
+    for (int i = 0; i < 5; i++) {
+        lines.push_back({i});
+        ASSERT_TRUE(qalloc::pointer::is_aligned(lines.data(), 64));
+    }
+    ASSERT_EQ(qalloc::type_of(lines.data()), typeid(cache_line_t));
+    ASSERT_EQ(lines.back().value, 4);
+    static_assert(qalloc::block_info_t::header_size_of<char>() == 4, "small types only pay for the block info");
+    static_assert(qalloc::block_info_t::header_size_of<double>() == alignof(double), "the header keeps the type aligned");
+    qalloc::pool_t small(256);
+    qalloc::allocator<int> ints(&small);
+    int* i = ints.allocate(1);
+    ASSERT_EQ(small.bytes_used(), sizeof(int) + sizeof(qalloc::block_info_t));
+    ASSERT_EQ(qalloc::type_of(i), typeid(int));
+    ints.deallocate(i, 1);
+}
+
+TEST(QAllocSingleThread, MonotonicRelease) {
+    qalloc::pool_t pool(256);
+    pool.set_mode(qalloc::pool_mode::monotonic);
+    qalloc::byte_pointer first = pool.allocate(64);
+    pool.deallocate(first, 64);
+    ASSERT_EQ(pool.bytes_used(), 64); // nothing is given back before release
+    qalloc::byte_pointer blocks[8];
+    pool.allocate_batch(64, 8, blocks); // spills into a second subpool
+    pool.deallocate_batch(blocks, 8, 64);
+    size_t pool_size = pool.pool_size();
+    pool.release();
+    ASSERT_EQ(pool.bytes_used(), 0);
+    ASSERT_EQ(pool.allocate(64), first);
+    pool.allocate_batch(64, 8, blocks); // the second subpool is reused
+    ASSERT_EQ(pool.pool_size(), pool_size);
+    pool.release();
+
+    pool.set_mode(qalloc::pool_mode::immediate);
+    {
+        std::vector<int, qalloc::simple_allocator<int>> v(qalloc::simple_allocator<int>{&pool});
+        v.resize(32);
+        ASSERT_EQ(reinterpret_cast<qalloc::byte_pointer>(v.data()), first);
+    }
+    ASSERT_EQ(pool.bytes_used(), 0);
+}
+
+TEST(QAllocSingleThread, CheckpointRewind) {
+    qalloc::pool_t pool(256);
+    qalloc::byte_pointer a = pool.allocate(32);
+    qalloc::pool_checkpoint_t mark = pool.checkpoint();
+    qalloc::byte_pointer b = pool.allocate(64);
+    pool.allocate(64);
+    pool.deallocate(b, 64);
+    pool.allocate(1024); // a subpool added after the mark
+    pool.rewind(mark);
+    ASSERT_EQ(pool.pool_size(), 256);
+    ASSERT_EQ(pool.bytes_used(), 32);
+    ASSERT_EQ(pool.allocate(64), a + 32);
+    {
+        qalloc::scope outer(pool);
+        std::vector<int, qalloc::simple_allocator<int>> v(qalloc::simple_allocator<int>{&pool});
+        v.resize(100);
+        {
+            qalloc::scope inner(pool);
+            pool.allocate(512);
+        }
+        ASSERT_EQ(pool.bytes_used(), 32 + 64 + 400);
+        v.clear();
+        v.shrink_to_fit();
+    }
+    ASSERT_EQ(pool.bytes_used(), 32 + 64);
+    ASSERT_EQ(pool.pool_size(), 256);
+}
+
+TEST(QAllocSingleThread, RewindKeepsNursery) {
+    qalloc::pool_t pool(256);
+    auto* message = reinterpret_cast<int*>(pool.allocate(sizeof(int), qalloc::lifetime_class::short_lived));
+    *message = 42;
+    size_t pool_size = pool.pool_size();
+    {
+        qalloc::scope scope(pool);
+        pool.allocate(1024); // a subpool added after the mark
+        pool.allocate(16, qalloc::lifetime_class::short_lived); // in the nursery from before the mark
+    }
+    ASSERT_EQ(pool.pool_size(), pool_size); // only the subpool added in the scope went
+    ASSERT_EQ(*message, 42);
+    pool.deallocate(reinterpret_cast<qalloc::byte_pointer>(message), sizeof(int));
+    ASSERT_EQ(pool.bytes_used(), 16);
+}
+
+TEST(QAllocSingleThread, UpstreamPool) {
+    qalloc::pool_t parent(4096);
+    {
+        qalloc::pool_t child(256, &parent);
+        ASSERT_EQ(child.upstream(), &parent);
+        ASSERT_EQ(parent.bytes_used(), 256);
+        child.allocate(32);
+        child.allocate(1024); // the second subpool comes from the parent too
+        ASSERT_EQ(child.pool_size(), 256 + 2048);
+        ASSERT_EQ(child.bytes_used(), 32 + 1024);
+        ASSERT_EQ(parent.bytes_used(), 256 + 2048);
+        child.release();
+        ASSERT_EQ(child.pool_size(), 256);
+        ASSERT_EQ(parent.bytes_used(), 256);
+    }
+    ASSERT_EQ(parent.bytes_used(), 0);
+    qalloc::pool_t child(1024, &parent);
+    qalloc::vector<int> v(qalloc::allocator<int>{&child});
+    v.resize(100);
+    ASSERT_EQ(parent.pool_size(), 4096); // recycled without asking the system
+}
+
+TEST(QAllocSingleThread, UpstreamPoolLargeSubpool) {
+    qalloc::pool_t parent(4096);
+    {
+        qalloc::pool_t child(512 << 10, &parent);
+        ASSERT_EQ(parent.large_bytes(), 0);
+        child.allocate(900 << 10); // the new subpool is a large block of the parent
+        ASSERT_GE(parent.large_bytes(), QALLOC_LARGE_BLOCK_SIZE);
+    } // both subpools go back the way they came
+    ASSERT_EQ(parent.large_bytes(), 0);
+    ASSERT_EQ(parent.bytes_used(), 0);
+}
+
+TEST(QAllocSingleThread, WinkOut) {
+    qalloc::wink::map<int, int> m;
+    for (int i = 0; i < 1000; i++) {
+        (*m)[i] = i;
+    }
+    qalloc::wink::vector<char> large;
+    large->resize(QALLOC_LARGE_BLOCK_SIZE);
+    ASSERT_EQ(large.pool().large_bytes(), QALLOC_LARGE_BLOCK_SIZE);
+    large.wink_out();
+    ASSERT_TRUE(large->empty());
+    ASSERT_EQ(large.pool().large_bytes(), 0);
+    size_t pool_size = m.pool().pool_size();
+    m.wink_out();
+    ASSERT_TRUE(m->empty());
+    ASSERT_EQ(m.pool().bytes_used(), 0);
+    for (int i = 0; i < 1000; i++) {
+        (*m)[i] = i;
+    }
+    ASSERT_EQ(m->size(), 1000);
+    ASSERT_EQ(m.pool().pool_size(), pool_size); // refilled from the kept subpools
+    qalloc::wink::vector<std::string> strings; // destroyed as usual
+    strings->emplace_back(100, 'a');
+}
+
+TEST(QAllocSingleThread, InlinePool) {
+    qalloc::inline_pool<256> pool;
+    auto in_pool_object = [&pool](const void* p) {
+        return p >= static_cast<const void*>(&pool) && p < static_cast<const void*>(&pool + 1);
+    };
+    {
+        std::basic_string<char, std::char_traits<char>, qalloc::inline_allocator<char, 256>> s(100, 'a', pool);
+        ASSERT_TRUE(in_pool_object(s.data()));
+    }
+    {
+        std::vector<int, qalloc::inline_allocator<int, 256>> v(pool);
+        v.reserve(16);
+        ASSERT_TRUE(in_pool_object(v.data()));
+        ASSERT_EQ(pool.pool_size(), 256);
+        v.resize(200); // spills into a subpool of its own
+        ASSERT_FALSE(in_pool_object(v.data()));
+        ASSERT_GT(pool.pool_size(), 256);
+    }
+    ASSERT_EQ(pool.bytes_used(), 0);
+    ASSERT_EQ(pool.gc(), 0); // the inline buffer is never given away
+}
+
+TEST(QAllocSingleThread, LifetimeSegregation) {
+    for (auto lifetime : {qalloc::lifetime_class::normal, qalloc::lifetime_class::short_lived}) {
+        qalloc::pool_t pool(1024);
+        std::vector<qalloc::byte_pointer> long_lived, short_lived;
+        for (int i = 0; i < 256; i++) {
+            if (i % 16 == 0) {
+                long_lived.push_back(pool.allocate(32));
+            }
+            else {
+                short_lived.push_back(pool.allocate(32, lifetime));
+            }
+        }
+        for (size_t i = 0; i < short_lived.size(); i++) {
+            pool.deallocate(short_lived[i], 32);
+            if (i % 8 == 0) { // must not land in the holes of a nursery
+                long_lived.push_back(pool.allocate(32));
+            }
+        }
+        size_t pool_size = pool.pool_size();
+        size_t memory_freed = pool.gc();
+        ASSERT_EQ(pool.pool_size(), pool_size - memory_freed);
+        ASSERT_EQ(pool.bytes_used(), long_lived.size() * 32);
+        if (lifetime == qalloc::lifetime_class::normal) {
+            ASSERT_EQ(memory_freed, 0); // every subpool is pinned by a long lived block
+        }
+        else {
+            ASSERT_EQ(memory_freed, 8 * 1024); // all nurseries
+        }
+        for (auto p : long_lived) {
+            pool.deallocate(p, 32);
+        }
+    }
+}
+
+TEST(QAllocSingleThread, ObjectPool) {
+    qalloc::object_pool<std::pair<std::string, int>> pool;
+    pool.reserve(100);
+    size_t capacity = pool.capacity();
+    ASSERT_GE(capacity, 100);
+    std::vector<std::pair<std::string, int>*> objects;
+    for (int i = 0; i < 1000; i++) {
+        objects.push_back(pool.create(std::to_string(i), i));
+    }
+    ASSERT_EQ(pool.size(), 1000);
+    for (int i = 0; i < 1000; i++) {
+        ASSERT_EQ(objects[i]->first, std::to_string(i));
+        ASSERT_EQ(objects[i]->second, i);
+    }
+    for (size_t i = 1; i < objects.size(); i++) { // one survivor pins the first slab
+        pool.destroy(objects[i]);
+    }
+    auto* reused = pool.create("reused", -1); // the last freed slot comes back first
+    ASSERT_EQ(reused, objects.back());
+    pool.destroy(reused);
+    pool.shrink_to_fit();
+    ASSERT_EQ(pool.size(), 1);
+    ASSERT_EQ(pool.capacity(), capacity);
+    pool.destroy(objects.front());
+    pool.shrink_to_fit();
+    ASSERT_EQ(pool.capacity(), 0);
+    ASSERT_EQ(pool.create("again", 0)->first, "again");
+}
+
+TEST(QAllocSingleThread, ObjectPoolLargeObject) {
+    using large_object_t = std::array<char, 96 << 10>; // its slabs are large blocks
+    qalloc::object_pool<large_object_t> pool;
+    std::vector<large_object_t*> objects;
+    for (int i = 0; i < 20; i++) {
+        objects.push_back(pool.create());
+        objects.back()->fill(static_cast<char>(i));
+    }
+    ASSERT_GE(pool.capacity(), 20);
+    for (int i = 0; i < 20; i++) {
+        ASSERT_EQ(objects[i]->back(), static_cast<char>(i));
+        pool.destroy(objects[i]);
+    }
+    pool.shrink_to_fit(); // the slabs go back to the system the way they came
+    ASSERT_EQ(pool.capacity(), 0);
+    ASSERT_NE(pool.create(), nullptr);
+}
+
+TEST(QAllocSingleThread, RecyclingPool) {
+    qalloc::recycling_pool<message_t> pool(2);
+    message_t* message = pool.acquire();
+    message->body.assign(1000, 'x');
+    message->fields.resize(100);
+    const char* body_buffer = message->body.data();
+    pool.release(message);
+    ASSERT_EQ(pool.n_retained(), 1);
+    message_t* recycled = pool.acquire();
+    ASSERT_EQ(recycled, message);
+    ASSERT_TRUE(recycled->body.empty()); // reset, but the buffers are still there
+    ASSERT_EQ(recycled->body.data(), body_buffer);
+    ASSERT_GE(recycled->fields.capacity(), 100);
+    {
+        auto a = pool.acquire_unique();
+        auto b = pool.acquire_unique();
+        auto c = pool.acquire_unique();
+    }
+    ASSERT_EQ(pool.n_retained(), 2); // bounded, the third one was destroyed
+    pool.set_max_retained(1);
+    ASSERT_EQ(pool.n_retained(), 1);
+    pool.release(recycled);
+    ASSERT_EQ(pool.n_retained(), 1);
+    ASSERT_EQ(&qalloc::get_recycling_pool<message_t>(), &qalloc::get_recycling_pool<message_t>());
+}
+
 TEST(QAllocMultiThread, QAllocString) {
     std::vector<std::thread> threads;
     for (int i = 0; i < 8; i++) {
@@ -150,6 +726,223 @@ TEST(QAllocMultiThread, QAllocVectorQAllocString) {
     }
 }
 
+TEST(QAllocMultiThread, PerCpuVectorInt) {
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 8; i++) {
+        threads.emplace_back([]() {
+            test_v<std::vector<int, qalloc::percpu_allocator<int>>>(emplace_index);
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    qalloc::percpu_allocator<double> allocator;
+    double* p = allocator.allocate(3);
+    ASSERT_TRUE(qalloc::pointer::is_aligned(p, alignof(double))); // the header is padded
+    allocator.deallocate(p, 3);
+    // blocks handed to another thread go back to the slot they came from, with or without rseq
+    std::vector<double*> blocks;
+    for (int i = 0; i < 64; i++) {
+        blocks.push_back(allocator.allocate(1 + i % 8));
+    }
+    std::size_t used = qalloc::internal::get_percpu_pool().bytes_used();
+    std::thread([&]() {
+        for (int i = 0; i < 64; i++) {
+            allocator.deallocate(blocks[i], 1 + i % 8);
+        }
+    }).join();
+    ASSERT_LT(qalloc::internal::get_percpu_pool().bytes_used(), used);
+}
+
+TEST(QAllocMultiThread, SharedPoolProducerConsumer) {
+    // messages of different size classes cross threads: allocated by producers, freed by consumers
+    using message_allocator = qalloc::shared_allocator<std::size_t>;
+    constexpr std::size_t N_PRODUCERS = 4;
+    constexpr std::size_t N_CONSUMERS = 4;
+    constexpr std::size_t N_MESSAGES = 20000; // per producer
+    qalloc::shared_pool_t pool;
+    std::mutex queue_mutex;
+    std::deque<std::pair<std::size_t*, std::size_t>> queue;
+    std::atomic<std::size_t> n_consumed{0};
+    std::vector<std::thread> threads;
+    for (std::size_t i = 0; i < N_PRODUCERS; i++) {
+        threads.emplace_back([&, i]() {
+            message_allocator allocator(&pool);
+            for (std::size_t j = 0; j < N_MESSAGES; j++) {
+                std::size_t n = 1 + (i + j) % 80; // up to 640 bytes, includes the non lock-free path
+                std::size_t* message = allocator.allocate(n);
+                for (std::size_t k = 0; k < n; k++) {
+                    message[k] = i * N_MESSAGES + j;
+                }
+                std::lock_guard<std::mutex> lock_guard(queue_mutex);
+                queue.emplace_back(message, n);
+            }
+        });
+    }
+    for (std::size_t i = 0; i < N_CONSUMERS; i++) {
+        threads.emplace_back([&]() {
+            message_allocator allocator(&pool);
+            while (n_consumed.load() < N_PRODUCERS * N_MESSAGES) {
+                std::pair<std::size_t*, std::size_t> message{nullptr, 0};
+                {
+                    std::lock_guard<std::mutex> lock_guard(queue_mutex);
+                    if (!queue.empty()) {
+                        message = queue.front();
+                        queue.pop_front();
+                    }
+                }
+                if (message.first == nullptr) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                for (std::size_t k = 1; k < message.second; k++) { // no block was handed out twice
+                    ASSERT_EQ(message.first[k], message.first[0]);
+                }
+                allocator.deallocate(message.first, message.second);
+                ++n_consumed;
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    ASSERT_EQ(n_consumed.load(), N_PRODUCERS * N_MESSAGES);
+}
+
+TEST(QAllocMultiThread, EpochReadersWriter) {
+    struct node_t {
+        std::size_t a;
+        std::size_t b;
+    };
+    constexpr std::size_t N_READERS = 4;
+    constexpr std::size_t N_UPDATES = 20000;
+    qalloc::shared_pool_t pool;
+    auto make_node = [&pool](std::size_t value) {
+        auto* node = reinterpret_cast<node_t*>(pool.allocate(sizeof(node_t)));
+        node->a = value;
+        node->b = value;
+        return node;
+    };
+    std::atomic<node_t*> current{make_node(0)};
+    std::atomic<bool> done{false};
+    std::atomic<std::size_t> n_torn{0};
+    std::vector<std::thread> threads;
+    for (std::size_t i = 0; i < N_READERS; i++) {
+        threads.emplace_back([&]() {
+            while (!done.load()) {
+                qalloc::epoch::guard guard;
+                node_t* node = current.load();
+                std::size_t a = node->a;
+                std::this_thread::yield(); // give the writer a chance to recycle the node
+                if (node->b != a) {
+                    ++n_torn;
+                }
+            }
+        });
+    }
+    threads.emplace_back([&]() {
+        for (std::size_t i = 1; i <= N_UPDATES; i++) {
+            node_t* old = current.exchange(make_node(i));
+            qalloc::epoch::retire(&pool, old, sizeof(node_t));
+        }
+        done.store(true);
+    });
+    for (auto& t : threads) {
+        t.join();
+    }
+    for (int i = 0; i < 4; i++) { // blocks left behind by the writer must go back before the pool dies
+        qalloc::epoch::reclaim();
+    }
+    ASSERT_EQ(n_torn.load(), 0);
+}
+
+TEST(QAllocMultiThread, EpochOrphanOwner) {
+    qalloc::pool_t pool(4096);
+    {
+        qalloc::epoch::guard guard; // keeps the blocks of the worker from being reclaimed before it exits
+        std::thread([&pool]() {
+            for (int i = 0; i < 8; i++) {
+                qalloc::epoch::retire(&pool, pool.allocate(64), 64);
+            }
+        }).join();
+    }
+    ASSERT_EQ(pool.bytes_used(), 8 * 64); // orphaned
+    for (int i = 0; i < 4 && pool.bytes_used() != 0; i++) {
+        qalloc::epoch::reclaim();
+    }
+    ASSERT_EQ(pool.bytes_used(), 0); // back in the pool they came from, not in the pool of this thread
+}
+
+TEST(QAllocMultiThread, BasicPoolOutlivesThread) {
+    std::vector<int, qalloc::basic_allocator<int>> v;
+    const void* p_pool = nullptr;
+    std::thread([&]() {
+        v.assign(100, 1);
+        p_pool = v.get_allocator().pool();
+    }).join();
+    ASSERT_EQ(v.get_allocator().pool(), p_pool); // still the pool of the finished thread
+    ASSERT_EQ(v[99], 1);
+    v.clear();
+    v.shrink_to_fit(); // freed into that pool, which was not destroyed with its thread
+}
+
+TEST(QAllocMultiThread, TransferPool) {
+    // build on one thread, hand the whole pool and the container over to another
+    std::unique_ptr<qalloc::pool_t> arena;
+    std::unique_ptr<qalloc::vector<int>> v;
+    std::thread([&]() {
+        v.reset(new qalloc::vector<int>());
+        for (int i = 0; i < 1000; i++) {
+            v->push_back(i);
+        }
+        arena = qalloc::detach_pool<int>();
+    }).join();
+    ASSERT_NE(arena, nullptr);
+    ASSERT_EQ(v->get_allocator().pool(), arena.get());
+    std::thread([&]() {
+        qalloc::pool_pointer p_arena = arena.get();
+        auto previous = qalloc::adopt_pool<int>(std::move(arena));
+        for (int i = 0; i < 1000; i++) {
+            ASSERT_EQ((*v)[i], i);
+        }
+        {
+            qalloc::vector<int> more(10, 0);
+            ASSERT_EQ(more.get_allocator().pool(), p_arena);
+        }
+        v.reset();
+        arena = qalloc::adopt_pool<int>(std::move(previous));
+    }).join();
+    ASSERT_EQ(arena->bytes_used(), 0);
+}
+
+TEST(QAllocMultiThread, DeallocationService) {
+    qalloc::pool_t pool(128);
+    qalloc::deallocation_service().start(QALLOC_LARGE_BLOCK_SIZE, 4);
+    std::vector<qalloc::byte_pointer> blocks;
+    for (int i = 0; i < 8; i++) {
+        blocks.push_back(pool.allocate(QALLOC_LARGE_BLOCK_SIZE));
+    }
+    ASSERT_EQ(pool.pool_size(), 128); // large blocks bypass the subpools
+    ASSERT_EQ(pool.large_bytes(), 8 * QALLOC_LARGE_BLOCK_SIZE);
+    for (auto* block : blocks) {
+        pool.deallocate(block, QALLOC_LARGE_BLOCK_SIZE); // frees inline whenever the queue is full
+    }
+    ASSERT_EQ(pool.large_bytes(), 0);
+    // aligned large blocks take the same path, and deallocate() finds where they start
+    qalloc::byte_pointer aligned = pool.allocate_aligned(QALLOC_LARGE_BLOCK_SIZE, 8192);
+    ASSERT_TRUE(qalloc::pointer::is_aligned(aligned, 8192));
+    ASSERT_EQ(pool.pool_size(), 128);
+    ASSERT_EQ(pool.large_bytes(), QALLOC_LARGE_BLOCK_SIZE);
+    pool.deallocate(aligned, QALLOC_LARGE_BLOCK_SIZE);
+    ASSERT_EQ(pool.large_bytes(), 0);
+    qalloc::deallocation_service().drain();
+    std::size_t n_offloaded = qalloc::deallocation_service().n_freed();
+    ASSERT_GE(n_offloaded, 1);
+    ASSERT_LE(n_offloaded, 8);
+    qalloc::deallocation_service().stop();
+    ASSERT_FALSE(qalloc::deallocation_service().submit(blocks.front(), QALLOC_LARGE_BLOCK_SIZE));
+}
+
 int main(int argc, char **argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();